@@ -0,0 +1,57 @@
+#ifndef BOUNDED_MATCH_H
+#define BOUNDED_MATCH_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 有界 SQDIFF 匹配（逐次排除） ====================
+//
+// 判定只需要知道是否存在归一化平方差 <= 1-阈值 的位置，不需要完整的得分图。
+// 对每个位置先用积分图得到窗口的像素和 ΣI 与能量 ΣI²，由
+//     SSD >= (sqrt(ΣI²) - sqrt(ΣT²))²     （三角不等式）
+//     SSD >= (ΣI - ΣT)² / N               （Cauchy-Schwarz）
+// 得到平方差下界；既不可能优于当前最小值、也不可能达到通过界限的位置直接排除。
+// 剩余位置逐行累加平方差，已累加部分加上剩余行的下界超过界限时提前放弃。
+// 找到通过的位置立即停止整个（模板, 角度）的搜索。
+//
+// 完整计算的位置按 OpenCV 的 TM_SQDIFF_NORMED 定义计算（SSD / sqrt(ΣI²·ΣT²)，上限为1），
+// 因此不提前停止时得到的最小值与 matchTemplate 一致（差异只来自 matchTemplate 的浮点误差）。
+
+// 剪枝统计
+struct BoundedMatchStats
+{
+    uint64_t positions = 0; // 检查的位置数
+    uint64_t empty = 0;     // 窗口内全为0（归一化平方差恒为1）
+    uint64_t pruned = 0;    // 被积分图下界排除
+    uint64_t abandoned = 0; // 逐行累加时提前放弃
+    uint64_t evaluated = 0; // 完整计算
+};
+
+class BoundedSqdiffMatcher
+{
+public:
+    // 预计算积分图（同一结果图上的所有模板、角度共用）
+    explicit BoundedSqdiffMatcher(const Mat &image);
+
+    /**
+     * @brief 在搜索区域内匹配一个模板
+     * @param templ 模板（CV_8UC1）
+     * @param searchArea 搜索区域（图像坐标，模板必须完整落在区域内）
+     * @param passValue 通过界限：归一化平方差 <= passValue 即通过并立即停止；为负数时求精确最小值
+     * @param bestValue 输入输出：当前最小归一化平方差（多个区域之间传递，初值为 1.0）
+     * @param stats 累加剪枝统计
+     * @return 找到通过的位置返回 true
+     */
+    bool match(const Mat &templ, const Rect &searchArea, double passValue,
+               double &bestValue, BoundedMatchStats &stats) const;
+
+private:
+    Mat m_image;
+    Mat m_sum;   // 积分图 ΣI（CV_64F）
+    Mat m_sqsum; // 积分图 ΣI²（CV_64F）
+};
+
+#endif // BOUNDED_MATCH_H
@@ -1,6 +1,10 @@
 #ifndef CONFIG_CONSTANTS_H
 #define CONFIG_CONSTANTS_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace Config
 {
     // 形态学处理参数 - 只使用膨胀操作
@@ -14,6 +18,11 @@ namespace Config
     // 图像缩放参数
     constexpr double RESIZE_SCALE = 0.05; // 图像缩放比例 (缩放到原尺寸的10%)
 
+    // JPEG 缩小解码倍数 (1/2/4/8)：解码时由 libjpeg 直接缩小，再缩放到 RESIZE_SCALE 对应的尺寸
+    // 注意：缩小解码的采样与全分辨率缩放不同，二值图会有少量像素差异、相似度会有约 ±0.07 的变化，
+    //       启用后需要重新确认模板阈值（可用 --record-scores + rejudge 对比）
+    constexpr int DECODE_REDUCTION = 1;
+
     // 模糊处理参数
     constexpr int BLUR_KERNEL_SIZE = 3; // 高斯模糊核大小
     constexpr double BLUR_SIGMA = 1;    // 高斯模糊标准差
@@ -36,16 +45,162 @@ namespace TemplateMatchConfig
     // 模板文件夹路径
     const std::string TEMPLATE_FOLDER = "image_samples/2/muban";
 
+    // 预编译模板库文件（由 compile-templates 生成，存在时启动直接 mmap，跳过扫描和解码）
+    const std::string TEMPLATE_BANK_FILE = "image_samples/2/muban.bank";
+
     // 旋转角度配置（用于处理筷子等细长物体的轻微倾斜）
     const double ROTATION_MIN = -6.0; // 最小旋转角度（度）
     const double ROTATION_MAX = 6.0;  // 最大旋转角度（度）
     const double ROTATION_STEP = 3.0; // 角度步长（度）
     // 实际测试角度：-15, -10, -5, 0, 5, 10, 15（7个角度）
 
+    // 方向估计：由连通域图像矩预测旋转角度，只匹配预测角度及其相邻一个步长
+    const bool ENABLE_ORIENTATION_ESTIMATE = true;
+    const double MIN_ORIENTATION_ELONGATION = 3.0; // 长短轴比低于此值视为过圆，方向不稳定，回退到全角度扫描
+    const double ORIENTATION_LENGTH_RATIO = 2.0;   // 连通域与模板主轴长度之比在 [1/r, r] 内才用于预测
+
+    // 只在连通域外接矩形周围（外扩模板尺寸）的候选窗口内匹配，空白帧几乎零开销
+    const bool ENABLE_CANDIDATE_WINDOWS = true;
+
+    // 有界匹配：积分图下界剪枝 + 逐行部分和提前放弃，找到达到阈值的位置立即停止（见 bounded_match.h）
+    // 未通过的角度得到精确最小值；通过的角度得分是第一个达到阈值的位置，不一定是该角度的最优位置
+    const bool ENABLE_BOUNDED_MATCH = true;
+
     // 每个模板的阈值（按文件名顺序：1.jpg, 2.jpg, ...）
     // 使用像素相似度匹配（TM_SQDIFF_NORMED），范围 [0, 1]，1.0=完全相同
     // 建议阈值：0.85-0.95
     const std::vector<double> THRESHOLDS = {0.85, 0.85};
 }
 
+// 处理流水线配置（声明式节点图，见 stage_graph.h）
+namespace PipelineConfig
+{
+    // 流水线配置文件：存在时覆盖下面的默认节点图，修改流程无需重新编译
+    const std::string GRAPH_FILE = "pipeline.txt";
+
+    // 每行一个节点：<输出名> = <阶段名>(<输入名>)，"input" 为原始BGR图像
+    // 可用阶段：resize, blur, clahe, hsv_mask, lab_mask, bgr2hsv, hsv_threshold,
+    //          morphology, contour_fill, fill_components, cc_filter
+    // 结果显示使用 resized / mask / morph / filled / final 这几个输出，模板匹配使用 final
+    // 例如改用LAB分割：mask = lab_mask(resized)；加模糊：blurred = blur(resized)，mask = ...(blurred)
+    const std::vector<std::string> DEFAULT_GRAPH = {
+        "resized = resize(input)",
+        // 整图HSV二值化。逐像素的 bgr2hsv + hsv_threshold 虽然能融合为逐行遍历、不生成整幅HSV图，
+        // 但每行要调用数次 OpenCV 函数，整帧近千次调度的开销超过省下的内存带宽，默认不用
+        "mask = hsv_mask(resized)",
+        "morph = morphology(mask)",
+        "filled = contour_fill(morph)",
+        "final = cc_filter(filled)",
+    };
+}
+
+// 单帧延迟预算配置（--budget <ms>，见 latency_budget.h）
+namespace LatencyBudgetConfig
+{
+    constexpr double DEFAULT_BUDGET_MS = 0.0; // 默认预算（0 表示不限，按原流程处理每一帧）
+    constexpr double SAFETY_MARGIN = 0.9;     // 预测耗时不超过剩余预算的90%时才使用该级别
+    constexpr double EWMA_ALPHA = 0.2;        // 各级别处理耗时的指数滑动平均系数
+
+    // 某级别超过这么多帧没有新样本时预测视为过期，改由当前使用级别的实测耗时按 LEVEL_COST_RATIO 估算
+    // （否则一段时间变慢后只有降级级别在更新，不降级的旧预测一直偏大，会永远停在降级级别）
+    constexpr uint64_t PREDICTION_STALE_FRAMES = 100;
+
+    // 某级别还没有实测样本时，相对于不降级的耗时估计（none, skip_diagnostics, fewer_angles, coarse_resize）
+    constexpr double LEVEL_COST_RATIO[] = {1.0, 0.95, 0.6, 0.4};
+
+    constexpr int REDUCED_ANGLE_COUNT = 1;      // fewer_angles 级别每个模板测试的角度数
+    constexpr double COARSE_SCALE_FACTOR = 0.5; // coarse_resize 级别的缩放比例 = RESIZE_SCALE * 此系数
+}
+
+// 工作线程拓扑配置（--workers / --cv-threads / --affinity，见 thread_topology.h）
+namespace ThreadTopologyConfig
+{
+    constexpr int DEFAULT_WORKERS = 1;     // 批量模式默认工作线程数
+    constexpr int DEFAULT_CV_THREADS = -1; // 每个工作线程的 OpenCV 线程数（<0 保持 OpenCV 默认）
+    constexpr int MAX_WORKERS = 64;        // 工作线程数上限
+}
+
+// 产品配方配置（多产品换产，见 recipe.h）
+namespace RecipeConfig
+{
+    const std::string RECIPE_FILE = "recipes.txt";   // 配方文件：存在时按其中的配方准备模板库
+    const std::string DEFAULT_RECIPE_NAME = "default"; // 配方文件不存在时，由本文件常量构成的配方名
+}
+
+// 模板匹配得分库配置（--batch ... --record-scores，rejudge）
+namespace ScoreStoreConfig
+{
+    const std::string DEFAULT_FILE = "template_scores.bin"; // 默认得分库文件（追加写入）
+}
+
+// 共享内存帧环配置（相机进程零拷贝输入）
+namespace FrameRingConfig
+{
+    const std::string DEFAULT_RING_NAME = "tableware_frames"; // 默认共享内存名称
+
+    constexpr int SLOT_COUNT = 4;                // 帧槽数量（环满时由生产者丢帧）
+    constexpr int RESULT_SLOT_COUNT = 64;        // 判定结果槽数量
+    constexpr int MAX_RESULT_TEMPLATES = 8;      // 每条判定结果最多携带的模板得分数
+    constexpr int MAX_RESULT_STAGES = 12;        // 每条判定结果最多携带的阶段耗时数
+    constexpr int RESULT_STAGE_NAME_LENGTH = 24; // 阶段名最大长度（含结尾0，超出截断）
+    constexpr int POLL_INTERVAL_US = 200;        // 无新帧时的轮询间隔（微秒）
+    constexpr int ATTACH_TIMEOUT_MS = 10000;     // 等待生产者创建并初始化共享内存的超时（毫秒）
+    constexpr int PRODUCER_TIMEOUT_MS = 5000;    // 生产者心跳超过此时间没有更新视为已退出（毫秒）
+}
+
+// 延迟直方图配置（见 latency_histogram.h）
+namespace LatencyHistogramConfig
+{
+    constexpr uint64_t MAX_VALUE_US = 60000000; // 可记录的最大延迟（微秒，60秒），超出按最大值计入
+    constexpr int SUB_BUCKET_BITS = 8;          // 相对精度：误差不超过 1/2^(8-1) ≈ 0.8%
+}
+
+// 运行指标导出配置（--metrics <file>，见 metrics.h）
+namespace MetricsConfig
+{
+    constexpr double WRITE_INTERVAL_S = 10.0; // 指标文件写入间隔（秒）
+    constexpr int MAX_STAGE_SERIES = 32;      // 最多记录的流水线阶段数（超出的阶段不导出）
+    constexpr int MAX_TEMPLATE_SERIES = 16;   // 最多记录的模板数
+
+    // 延迟直方图导出的 le 边界（毫秒，导出时换算为秒）
+    constexpr double LATENCY_BUCKETS_MS[] = {0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500};
+
+    // 模板得分（相似度 0-1）直方图的 le 边界
+    constexpr double SCORE_BUCKETS[] = {0.5, 0.6, 0.7, 0.75, 0.8, 0.85, 0.9, 0.95, 0.98, 1.0};
+}
+
+// NG 证据留存配置（--evidence <folder>，见 evidence_capture.h）
+namespace EvidenceConfig
+{
+    constexpr int QUEUE_CAPACITY = 32;     // 待写入队列容量（帧），满时丢弃最旧的一帧
+    constexpr int DEFAULT_QUOTA_MB = 2048; // 默认磁盘配额（MB），可用 --evidence-quota 覆盖
+    constexpr int JPEG_QUALITY = 90;       // 缩放图和叠加图的 JPEG 质量
+    constexpr int PNG_COMPRESSION = 1;     // 二值图的 PNG 压缩级别（0-9，二值图级别 1 已足够小）
+}
+
+// 合成负载生成器配置（load_generator 工具）
+namespace LoadGeneratorConfig
+{
+    constexpr double DEFAULT_RATE = 10.0;          // 默认目标帧率（fps，0 表示闭环：有空槽就发）
+    constexpr int POOL_SIZE = 8;                   // 预生成的变换帧数量（全分辨率帧每张约36MB）
+    constexpr int GENERATOR_THREADS = 1;           // 后台持续替换帧池的线程数（0 表示帧池生成后不再变化）
+    constexpr double MAX_SHIFT_FRACTION = 0.03;    // 随机平移上限（占宽/高的比例）
+    constexpr int HUE_JITTER = 3;                  // 色调随机偏移上限（OpenCV H 通道，0-179）
+    constexpr double BRIGHTNESS_JITTER = 0.10;     // 亮度（V 通道）随机缩放上限（±10%）
+    constexpr int JPEG_QUALITY_MIN = 70;           // 重新编码的 JPEG 质量范围
+    constexpr int JPEG_QUALITY_MAX = 95;
+    constexpr int REPORT_INTERVAL_S = 60;          // 区间统计输出间隔（秒）
+    constexpr int RESULT_TIMEOUT_S = 30;           // 结束后等待剩余判定的时间（秒）
+    const std::string HISTOGRAM_FILE = "load_latency.hgrm"; // 延迟分布输出文件（每个区间覆盖写入）
+}
+
+// 分阶段内存统计配置（--batch ... --memprofile）
+namespace MemoryAccountingConfig
+{
+    const std::string BASELINE_FILE = "memory_baseline.txt"; // 默认基线文件（不存在时由本次结果生成）
+
+    constexpr double REGRESSION_TOLERANCE = 0.10; // 每帧分配量/次数/峰值超过基线10%视为回归
+    constexpr double REGRESSION_MIN_BYTES = 4096; // 字节数增长低于此值时忽略（避免小数值抖动误报）
+}
+
 #endif // CONFIG_CONSTANTS_H
\ No newline at end of file
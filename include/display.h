@@ -1,6 +1,7 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include "image_processing.h"
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <string>
@@ -16,6 +17,17 @@ Mat createSubplotDisplay(const vector<Mat> &images,
                          const vector<string> &titles,
                          int rows, int cols);
 
+// 将subplot绘制到canvas（尺寸不变时复用canvas内存）
+void renderSubplotDisplay(const vector<Mat> &images,
+                          const vector<string> &titles,
+                          int rows, int cols, Mat &canvas);
+
+// 绘制完整检测结果画布：2x3子图 + 底部模板匹配结果 + 耗时 + 右上角OK/NG判定
+void renderDetectionCanvas(const vector<Mat> &images,
+                           const vector<string> &titles,
+                           const vector<TemplateMatchResult> &matchResults,
+                           bool isOK, int algorithmMs, int totalMs, Mat &canvas);
+
 // 显示交互式颜色分析窗口
 void showColorAnalysis(const Mat &hsvImage, const Mat &originalImage);
 
@@ -0,0 +1,113 @@
+#ifndef EVIDENCE_CAPTURE_H
+#define EVIDENCE_CAPTURE_H
+
+#include "image_processing.h"
+#include "template_bank.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== NG 证据留存 ====================
+//
+// 每个 NG 帧保留缩放图、二值图、final 和最佳匹配叠加图，用于追溯。编码和写盘不在检测线程中进行：
+//   检测线程 --submit()--> 有界队列（只移交 Mat 引用计数） --> 写入线程编码、写盘
+// 队列满时丢弃最旧的一帧，检测线程不会因为写盘而等待；磁盘占用超过配额时删除最旧的证据目录。
+// 每帧一个目录：<证据文件夹>/<时间>_<帧名>/{resized.jpg, mask.png, final.png, overlay.jpg, result.txt}
+
+// 检测线程交给写入线程的一帧
+struct EvidenceFrame
+{
+    string name;                              // 图片名或帧序号
+    chrono::system_clock::time_point capturedAt;
+    Mat resized;                              // 缩放后的图像
+    Mat mask;                                 // HSV二值化结果
+    Mat finalResult;                          // 连通域过滤结果（模板匹配输入）
+    vector<TemplateMatchResult> matchResults; // 每个模板的匹配结果
+    vector<Mat> bestTemplates;                // 每个模板最佳角度的旋转模板（与 matchResults 对应，可为空）
+};
+
+/**
+ * @brief 由流水线输出构造证据帧（图像只共享引用计数；最佳角度模板很小，复制一份，不依赖模板库的生命周期）
+ * @param name 图片名或帧序号
+ * @param result 流水线输出
+ * @param bank 本帧使用的模板库
+ */
+shared_ptr<EvidenceFrame> makeEvidenceFrame(const string &name, const DetectionPipelineResult &result,
+                                            const TemplateBank &bank);
+
+class EvidenceCapture
+{
+public:
+    EvidenceCapture() = default;
+    ~EvidenceCapture();
+
+    EvidenceCapture(const EvidenceCapture &) = delete;
+    EvidenceCapture &operator=(const EvidenceCapture &) = delete;
+
+    /**
+     * @brief 启动写入线程（文件夹中已有的证据目录计入配额）
+     * @param folder 证据文件夹（不存在时创建）
+     * @param quotaBytes 磁盘配额（字节）
+     * @param queueCapacity 队列容量（帧）
+     */
+    bool start(const string &folder, uint64_t quotaBytes, size_t queueCapacity);
+
+    // 提交一帧（检测线程调用，不阻塞；队列满时丢弃最旧的一帧）
+    void submit(shared_ptr<EvidenceFrame> frame);
+
+    // 写完队列中剩余的帧后停止写入线程
+    void stop();
+
+    bool running() const { return m_running.load(); }
+
+    size_t queueDepth() const { return m_queueDepth.load(); }
+    uint64_t submittedFrames() const { return m_submitted.load(); }
+    uint64_t writtenFrames() const { return m_written.load(); }
+    uint64_t droppedFrames() const { return m_dropped.load(); }  // 队列满被丢弃
+    uint64_t evictedFrames() const { return m_evicted.load(); }  // 超出配额被删除
+    uint64_t writeErrors() const { return m_writeErrors.load(); }
+    uint64_t diskBytes() const { return m_diskBytes.load(); }
+
+    void printSummary() const;
+
+private:
+    void run();
+    bool writeFrame(const EvidenceFrame &frame, uint64_t &bytes);
+    void enforceQuota();
+
+    string m_folder;
+    uint64_t m_quotaBytes = 0;
+    size_t m_capacity = 0;
+
+    mutex m_mutex;
+    condition_variable m_condition;
+    deque<shared_ptr<EvidenceFrame>> m_queue;
+    bool m_stopRequested = false;
+    thread m_thread;
+    atomic<bool> m_running{false};
+
+    // 以下成员只在写入线程中访问：已写入的证据目录（按时间从旧到新）及其大小
+    deque<pair<string, uint64_t>> m_stored;
+
+    atomic<size_t> m_queueDepth{0};
+    atomic<uint64_t> m_submitted{0};
+    atomic<uint64_t> m_written{0};
+    atomic<uint64_t> m_dropped{0};
+    atomic<uint64_t> m_evicted{0};
+    atomic<uint64_t> m_writeErrors{0};
+    atomic<uint64_t> m_diskBytes{0};
+};
+
+#endif // EVIDENCE_CAPTURE_H
@@ -0,0 +1,160 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include "shared_memory.h"
+#include "config_constants.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 共享内存布局 ====================
+//
+// [FrameRingHeader][帧槽 0]...[帧槽 N-1][结果槽 0]...[结果槽 M-1]
+//
+// 帧槽：生产者（相机进程）写入 BGR 原始数据，消费者（检测进程）直接在映射内存上
+// 构造 Mat 头运行流水线，不做任何拷贝。生产者只在 writeSeq - readSeq < slotCount 时
+// 写入新帧，因此消费者持有的槽在 release 之前不会被覆盖；环满时由生产者丢帧。
+//
+// 结果槽：消费者按帧顺序写回判定，使用序号校验（seqlock）防止读到写了一半的结果。
+//
+// 生产者最后写入 magic：消费者看到 magic 之前头部可能还没有初始化（共享内存已创建但尚未写完），
+// 此时继续等待而不是报格式错误。生产者异常退出时不会设置 producerDone，消费者由心跳超时发现。
+
+constexpr uint32_t FRAME_RING_MAGIC = 0x52465754; // "TWFR"
+constexpr uint32_t FRAME_RING_VERSION = 4;
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "共享内存中的原子变量必须是无锁的");
+static_assert(atomic<uint32_t>::is_always_lock_free, "共享内存中的原子变量必须是无锁的");
+
+struct FrameRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;       // 帧槽数量
+    uint32_t resultSlotCount; // 结果槽数量
+    uint32_t maxWidth;        // 单帧最大宽度
+    uint32_t maxHeight;       // 单帧最大高度
+    uint64_t slotStride;      // 每个帧槽字节数（含槽头）
+    uint64_t framesOffset;    // 第一个帧槽的偏移
+    uint64_t resultsOffset;   // 第一个结果槽的偏移
+    uint64_t totalSize;       // 共享内存总大小
+
+    alignas(64) atomic<uint64_t> writeSeq;   // 生产者已发布的帧数
+    alignas(64) atomic<uint64_t> readSeq;    // 消费者已释放的帧数
+    alignas(64) atomic<uint64_t> resultSeq;  // 消费者已发布的判定数
+    atomic<uint64_t> droppedFrames;          // 环满时生产者丢弃的帧数
+    atomic<uint32_t> producerDone;           // 生产者不再发布新帧
+    atomic<uint32_t> consumerAttached;       // 消费者已连接
+    alignas(64) atomic<uint64_t> producerHeartbeatNs; // 生产者最近一次活动（steady_clock 纳秒，发帧和读判定时更新）
+};
+
+// 帧槽头，紧随其后是 height * step 字节的 BGR 数据
+struct alignas(64) FrameSlotHeader
+{
+    uint64_t sequence;    // 帧序号（从0开始）
+    uint64_t timestampNs; // 生产者发布时刻（steady_clock 纳秒）
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;        // 每行字节数
+};
+
+// 判定结果槽
+struct alignas(64) FrameResultSlot
+{
+    atomic<uint64_t> tag; // 结果序号+1，0 表示正在写入；读取前后都须等于期望的结果序号+1
+    uint64_t sequence;    // 对应的帧序号
+    uint64_t timestampNs; // 对应帧的发布时刻（用于计算端到端延迟）
+    uint32_t processingUs;
+    int32_t isOK;
+    uint32_t templateCount;
+    float scores[FrameRingConfig::MAX_RESULT_TEMPLATES];
+    float angles[FrameRingConfig::MAX_RESULT_TEMPLATES];
+    int32_t degraded;      // 因延迟预算降级处理
+    uint32_t degradeLevel; // DegradeLevel
+    uint32_t stageCount;
+    float stageMs[FrameRingConfig::MAX_RESULT_STAGES];
+    char stageNames[FrameRingConfig::MAX_RESULT_STAGES][FrameRingConfig::RESULT_STAGE_NAME_LENGTH];
+};
+
+// 单帧判定（结果环中传递的内容）
+struct FrameVerdict
+{
+    uint64_t sequence = 0;
+    uint64_t timestampNs = 0;
+    uint32_t processingUs = 0;
+    bool isOK = false;
+    vector<float> scores;                // 每个模板的相似度（通过的模板可能是早停位置的得分，见 TemplateMatchResult::scoreExact）
+    vector<float> angles;                // 每个模板的最佳角度
+    bool degraded = false;               // 因延迟预算降级处理
+    uint32_t degradeLevel = 0;           // DegradeLevel
+    vector<pair<string, float>> stageMs; // 各阶段耗时（毫秒，按执行顺序）
+};
+
+// ==================== 生产者（相机进程一侧） ====================
+
+class FrameRingProducer
+{
+public:
+    // 创建共享内存帧环
+    bool create(const string &name, int maxWidth, int maxHeight);
+
+    // 消费者是否已连接
+    bool consumerAttached() const;
+
+    // 发布一帧（拷贝到帧槽）。环满时丢帧并返回 false
+    bool tryPush(const Mat &bgrFrame, uint64_t &sequence);
+
+    // 按顺序读取下一条判定，没有新结果时返回 false
+    bool pollResult(FrameVerdict &verdict);
+
+    // 通知消费者不会再有新帧
+    void markDone();
+
+    uint64_t publishedFrames() const;
+    uint64_t droppedFrames() const;
+    uint64_t lostResults() const { return m_lostResults; }
+
+private:
+    MappedRegion m_region;
+    FrameRingHeader *m_header = nullptr;
+    uint64_t m_nextResult = 0;
+    uint64_t m_lostResults = 0; // 结果环被覆盖而未读到的判定数
+};
+
+// ==================== 消费者（检测进程一侧） ====================
+
+class FrameRingConsumer
+{
+public:
+    // 连接到已存在的帧环，等待生产者创建，超时返回 false
+    bool attach(const string &name, int timeoutMs);
+
+    // 获取下一帧：frame 是指向共享内存的 Mat 头（零拷贝），没有新帧时返回 false
+    bool acquire(Mat &frame, uint64_t &sequence, uint64_t &timestampNs);
+
+    // 释放当前帧槽，之后 frame 不能再被访问
+    void release();
+
+    // 写回判定
+    void publishResult(const FrameVerdict &verdict);
+
+    // 生产者已结束且没有待处理的帧
+    bool finished() const;
+
+    // 生产者心跳超过 timeoutMs 没有更新（进程已退出或卡死）
+    bool producerLost(int timeoutMs) const;
+
+private:
+    MappedRegion m_region;
+    FrameRingHeader *m_header = nullptr;
+    uint64_t m_current = 0;
+    bool m_holding = false;
+};
+
+#endif // FRAME_RING_H
@@ -0,0 +1,44 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 检测用图像解码 ====================
+//
+// imread(IMREAD_COLOR) 会先把整幅原图按 EXIF 方向旋转，而流水线马上又把它缩小20倍。
+// 这里改为忽略 EXIF 方向解码（可选 libjpeg 缩小解码），自己读取 EXIF 方向，
+// 由缩放阶段在缩小后的图像上做转置/翻转。
+
+// 解码信息（传给流水线的缩放阶段）
+struct DecodedImageInfo
+{
+    int exifOrientation = 1; // EXIF 方向 (1-8)，1 为无需变换
+    Size sourceSize;         // 原始分辨率（未缩小、未按方向变换）；为空表示与解码结果一致
+    int reduction = 1;       // 实际使用的解码缩小倍数
+};
+
+/**
+ * @brief 只读取 JPEG 文件头，得到 EXIF 方向和原始分辨率
+ * @param path 图像路径
+ * @param imageSize 输出：SOF 中的原始宽高（不是 JPEG 或未找到时为空）
+ * @return EXIF 方向 (1-8)，没有方向标签或不是 JPEG 时返回 1
+ */
+int readJpegOrientation(const string &path, Size &imageSize);
+
+// 按 EXIF 方向变换图像（与 OpenCV imread 的处理一致）
+void applyExifOrientation(const Mat &src, Mat &dst, int orientation);
+
+/**
+ * @brief 检测用解码：JPEG 忽略 EXIF 方向解码，reduction 为 2/4/8 时使用缩小解码
+ * @param path 图像路径
+ * @param reduction 缩小倍数（1 为全分辨率）
+ * @param info 输出：EXIF 方向和原始分辨率，交给缩放阶段处理
+ * @return 解码结果（未按方向变换），失败时为空
+ */
+Mat decodeImageForDetection(const string &path, int reduction, DecodedImageInfo &info);
+
+#endif // IMAGE_DECODE_H
@@ -0,0 +1,20 @@
+#ifndef IMAGE_FILES_H
+#define IMAGE_FILES_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief 列出文件夹中的图片文件（.jpg .jpeg .png .bmp .tif .tiff，扩展名不区分大小写），按名称排序
+ *
+ * 批量检测、模板库构建、帧生产者和负载生成器共用，各处接受的图片类型保持一致。
+ * @param folder 文件夹路径
+ * @param files 输出：图片文件（不含子目录）；文件夹中没有图片时为空，由调用者决定是否报错
+ * @param fullPaths true 输出完整路径，false 只输出文件名
+ * @return 文件夹不存在或读取失败返回 false
+ */
+bool listImageFiles(const string &folder, vector<string> &files, bool fullPaths = true);
+
+#endif // IMAGE_FILES_H
@@ -1,7 +1,13 @@
 #ifndef IMAGE_PROCESSING_H
 #define IMAGE_PROCESSING_H
 
+#include "template_bank.h"
+#include "stage_graph.h"
+#include "image_decode.h"
+#include "latency_budget.h"
 #include <opencv2/opencv.hpp>
+#include <ostream>
+#include <sstream>
 #include <vector>
 
 using namespace cv;
@@ -16,6 +22,9 @@ Mat applyBlurProcessing(const Mat &inputImage);
 // 多HSV二值分割函数 (直接接受BGR图像)
 Mat createHueBinaryMask(const Mat &bgrImage);
 
+// 多HSV二值分割函数（使用给定的颜色范围，如配方中的范围）
+Mat createHueBinaryMask(const Mat &bgrImage, const vector<HsvRange> &ranges);
+
 // LAB色彩空间二值分割函数
 Mat createLABBinaryMask(const Mat &bgrImage);
 
@@ -31,6 +40,10 @@ Mat fillConnectedComponents(const Mat &binaryImage);
 // 基于全图面积百分比的连通域过滤函数
 Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercentage = 2.0);
 
+// 基于全图面积百分比的连通域过滤函数（同时输出保留下来的连通域外接矩形、面积和主轴方向）
+Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercentage,
+                                       vector<BlobOrientation> &components);
+
 // CLAHE对比度限制自适应直方图均衡
 Mat enhanceContrast_CLAHE(const Mat &inputImage);
 
@@ -40,9 +53,14 @@ Mat enhanceContrast_CLAHE(const Mat &inputImage);
 struct TemplateMatchResult
 {
     string filename;  // 模板文件名
-    double score;     // 匹配得分
+    double score;     // 匹配得分（scoreExact 为 false 时只是下界，见下）
     double bestAngle; // 最佳匹配角度
     bool passed;      // 是否通过
+    vector<float> angleScores; // 每个预旋转角度的相似度（按模板库变体顺序），未测试的角度为 NaN
+    double matchMs = 0.0;      // 本模板的匹配耗时（毫秒）
+    // score 是否为测试角度内的最佳相似度。有界匹配找到第一个达到阈值的位置即停止，此时 score 是该位置的
+    // 得分（>= 阈值，不一定最佳），为 false；未通过或记录全部角度得分（testAllAngles）时为 true
+    bool scoreExact = true;
 };
 
 /**
@@ -59,4 +77,100 @@ bool judgeByTemplateMatch(
     const vector<double> &thresholds,
     vector<TemplateMatchResult> &results);
 
+/**
+ * @brief 使用已准备好的模板库进行模板匹配判断（不访问磁盘）
+ * @param resultImage 检测结果图像（二值图）
+ * @param bank 模板库（含阈值和预旋转模板）
+ * @param results 输出：每个模板的匹配结果
+ * @return true=全部通过(OK), false=有失败(NG)
+ */
+bool judgeByTemplateBank(
+    const Mat &resultImage,
+    const TemplateBank &bank,
+    vector<TemplateMatchResult> &results);
+
+/**
+ * @brief 使用已知的连通域统计进行模板匹配判断，只在连通域周围的候选窗口内匹配
+ * @param resultImage 检测结果图像（二值图）
+ * @param components 结果图中的连通域（来自 filterConnectedComponentsByPercent）
+ * @param bank 模板库
+ * @param results 输出：每个模板的匹配结果
+ * @param testAllAngles 为 true 时不早停，测试所有选中的角度并求每个角度的精确最小值（记录得分用，判定结果不变）
+ * @param budget 本帧延迟预算（可为空）：按降级级别省略诊断统计、减少角度，剩余预算不足时停止测试后续角度
+ * @return true=全部通过(OK), false=有失败(NG)
+ */
+bool judgeByTemplateBank(
+    const Mat &resultImage,
+    const vector<BlobOrientation> &components,
+    const TemplateBank &bank,
+    vector<TemplateMatchResult> &results,
+    bool testAllAngles = false,
+    FrameBudget *budget = nullptr);
+
+// ==================== 完整检测流水线 ====================
+
+// 单帧检测结果（保留中间图像用于显示）
+struct DetectionPipelineResult
+{
+    Mat resizedImage;                         // 缩放后的图像
+    Mat originalBinary;                       // HSV二值化结果
+    Mat morphProcessed;                       // 形态学处理结果
+    Mat contourFilled;                        // 轮廓填充结果
+    Mat finalResult;                          // 连通域过滤结果
+    vector<BlobOrientation> components;       // 保留下来的连通域统计
+    vector<TemplateMatchResult> matchResults; // 每个模板的匹配结果
+    bool isOK = false;                        // 最终判定
+
+    // 延迟预算（未启用预算时 degraded 恒为 false）
+    bool degraded = false;                        // 本帧是否降级处理
+    DegradeLevel degradeLevel = DegradeLevel::None; // 本帧降级级别
+    vector<pair<string, double>> stageMs;         // 每个阶段的耗时（流水线各步骤 + 模板匹配）
+};
+
+// ==================== 逐帧输出 ====================
+//
+// 流水线和模板匹配的逐帧诊断输出写到 frameLog()：默认就是 cout；多个工作线程并行时，
+// 工作线程用 FrameLogCapture 把本线程的输出改写到自己的缓冲区，每帧结束后在输出锁内一次性打印，
+// 各帧的输出不会交错，也不会并发修改 cout 的格式状态（fixed / setprecision）。
+
+// 当前线程的逐帧输出流
+ostream &frameLog();
+
+// 在作用域内把当前线程的 frameLog() 改写到 buffer
+class FrameLogCapture
+{
+public:
+    explicit FrameLogCapture(ostringstream &buffer);
+    ~FrameLogCapture();
+
+    FrameLogCapture(const FrameLogCapture &) = delete;
+    FrameLogCapture &operator=(const FrameLogCapture &) = delete;
+
+private:
+    ostream *m_previous;
+};
+
+/**
+ * @brief 按配置构建检测流水线（pipeline.txt 存在时使用它，否则使用 PipelineConfig::DEFAULT_GRAPH）
+ * @param keepIntermediates 是否保留中间结果用于显示；为 false 时只保留 final，不需要的节点被跳过
+ * @param graph 输出：已编译的流水线
+ */
+bool buildDetectionGraph(bool keepIntermediates, StageGraph &graph);
+
+/**
+ * @brief 对一帧BGR图像执行完整检测流水线：按节点图处理得到 final，再进行模板匹配
+ * @param bgrImage 输入图像（可以是指向外部内存的Mat头，函数不会修改它）
+ * @param recipe 本帧使用的配方（HSV 范围和模板库）
+ * @param graph 已编译的流水线（记录每个节点的耗时）
+ * @param output 输出：中间结果（未保留的为空）和判定
+ * @param testAllAngles 为 true 时模板匹配不早停（见 judgeByTemplateBank）
+ * @param decodeInfo 解码信息（decodeImageForDetection 的输出）：EXIF 方向和原始分辨率由缩放阶段处理
+ * @param budget 本帧延迟预算（可为空）：降级到 coarse_resize 时以更粗的比例分割，final 放大回正常尺寸后匹配
+ * @return true=OK, false=NG
+ */
+bool runDetectionPipeline(const Mat &bgrImage, const Recipe &recipe, StageGraph &graph,
+                          DetectionPipelineResult &output, bool testAllAngles = false,
+                          const DecodedImageInfo &decodeInfo = DecodedImageInfo(),
+                          FrameBudget *budget = nullptr);
+
 #endif // IMAGE_PROCESSING_H
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef LATENCY_BUDGET_H
+#define LATENCY_BUDGET_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// ==================== 单帧延迟预算 ====================
+//
+// 生产线上迟到的判定和错误的判定一样没有用。启用预算（--budget <ms>）后，每帧从到达
+// （相机发布或开始解码）起计时；帧开始处理时根据前几帧的实测耗时预测本帧耗时，
+// 剩余预算不够时按固定顺序逐级降级（每一级包含前面各级）：
+//   1. 跳过诊断统计（结果图 countNonZero 和密度输出），不影响判定
+//   2. 每个模板只测试方向估计/中心扩散顺序中最靠前的角度
+//   3. 以更粗的缩放比例做分割，final 再放大回正常尺寸后匹配
+// 模板匹配过程中剩余预算不足以再测一个角度时，也会停止测试后续角度。
+// 长时间没有使用的级别预测会过期，改由当前级别的实测耗时估算，负载恢复后能回到较低的级别。
+// 判定结果带有降级标志和每个阶段的耗时。
+
+// 降级级别（按顺序累加）
+enum class DegradeLevel
+{
+    None = 0,
+    SkipDiagnostics,
+    FewerAngles,
+    CoarseResize,
+    Count
+};
+
+const char *degradeLevelName(DegradeLevel level);
+
+// 单帧预算（未启用时所有查询都表示"不降级"）
+class FrameBudget
+{
+public:
+    FrameBudget() = default;
+    FrameBudget(chrono::steady_clock::time_point frameStart, double budgetMs, DegradeLevel level);
+
+    bool enabled() const { return m_budgetMs > 0.0; }
+    double budgetMs() const { return m_budgetMs; }
+    DegradeLevel level() const { return m_level; }
+
+    // 是否已降级到 level（含）以上
+    bool atLeast(DegradeLevel level) const { return enabled() && m_level >= level; }
+
+    // 从帧到达起已用时间 / 剩余预算（毫秒）
+    double elapsedMs() const;
+    double remainingMs() const;
+
+    // 从开始处理（选择降级级别）起的耗时
+    double processingMs() const;
+
+    // 匹配过程中因预算不足少测了角度
+    void markAnglesCut() { m_anglesCut = true; }
+    bool anglesCut() const { return m_anglesCut; }
+
+    bool degraded() const { return m_level != DegradeLevel::None || m_anglesCut; }
+
+    // 记录阶段耗时（按执行顺序）
+    void recordStage(const string &name, double ms) { m_stages.emplace_back(name, ms); }
+    const vector<pair<string, double>> &stages() const { return m_stages; }
+
+private:
+    chrono::steady_clock::time_point m_frameStart;
+    chrono::steady_clock::time_point m_processingStart;
+    double m_budgetMs = 0.0;
+    DegradeLevel m_level = DegradeLevel::None;
+    bool m_anglesCut = false;
+    vector<pair<string, double>> m_stages;
+};
+
+// 预算控制器：记录各降级级别的实测处理耗时，为每帧选择降级级别
+class LatencyBudgetController
+{
+public:
+    // budgetMs <= 0 表示不启用
+    explicit LatencyBudgetController(double budgetMs);
+
+    bool enabled() const { return m_budgetMs > 0.0; }
+
+    // 帧开始处理时调用：frameStart 为帧到达时刻（之前的等待和解码也计入预算）
+    FrameBudget beginFrame(chrono::steady_clock::time_point frameStart);
+
+    // 帧处理结束后调用：更新耗时预测和统计
+    void endFrame(const FrameBudget &budget);
+
+    // 输出降级和超时统计
+    void printSummary() const;
+
+private:
+    double predictedMs(int level) const;
+
+    // 该级别有未过期的实测样本
+    bool isFresh(int level) const;
+
+    static constexpr int LEVEL_COUNT = int(DegradeLevel::Count);
+
+    double m_budgetMs = 0.0;
+    double m_predictedMs[LEVEL_COUNT] = {};
+    bool m_measured[LEVEL_COUNT] = {};
+    uint64_t m_lastSampleFrame[LEVEL_COUNT] = {}; // 最近一次实测样本的帧序号
+    uint64_t m_frames = 0;
+    uint64_t m_levelFrames[LEVEL_COUNT] = {};
+    uint64_t m_anglesCutFrames = 0;
+    uint64_t m_overruns = 0;
+};
+
+#endif // LATENCY_BUDGET_H
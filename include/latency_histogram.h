@@ -0,0 +1,61 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ==================== 延迟直方图 ====================
+//
+// HDR 风格的对数-线性分桶：小于 2^S 的值逐个计数，之后每个 2 的幂区间再均分为 2^(S-1) 个桶，
+// 任何值的相对误差不超过 1/2^(S-1)（S = LatencyHistogramConfig::SUB_BUCKET_BITS）。
+// 桶数固定、记录是 O(1) 的数组自增，适合长时间运行时记录每一帧的延迟。
+// 单位由调用方决定（本项目统一使用微秒）。
+
+class LatencyHistogram
+{
+public:
+    // 可记录的最大值（超出的值按最大值计入），相对精度位数
+    explicit LatencyHistogram(uint64_t maxValue, int subBucketBits);
+    LatencyHistogram();
+
+    void record(uint64_t value);
+    void reset();
+
+    // 累加另一个直方图（两者的范围和精度必须相同）
+    bool merge(const LatencyHistogram &other);
+
+    uint64_t count() const { return m_count; }
+    uint64_t minValue() const { return m_count > 0 ? m_min : 0; }
+    uint64_t maxValue() const { return m_max; }
+    double mean() const;
+
+    // 百分位（0-100），返回该值所在桶的上界（不超过实际最大值）
+    uint64_t percentile(double percent) const;
+
+    /**
+     * @brief 写出百分位分布（HdrHistogram .hgrm 兼容的文本格式，可直接用其绘图工具查看）
+     * @param path 输出文件
+     * @param unitScale 输出值 = 记录值 / unitScale（例如微秒记录、毫秒输出时为 1000）
+     */
+    bool writePercentileDistribution(const string &path, double unitScale) const;
+
+    // 分桶布局（供按线程分片的无锁直方图复用同一分桶，见 metrics.h）
+    size_t bucketCount() const { return m_counts.size(); }
+    size_t bucketIndex(uint64_t value) const; // value 超出范围时按最大值分桶
+    uint64_t bucketUpperBound(size_t index) const;
+
+private:
+    uint64_t m_maxTrackable = 0;
+    int m_subBucketBits = 0;
+    vector<uint64_t> m_counts;
+    uint64_t m_count = 0;
+    uint64_t m_min = UINT64_MAX;
+    uint64_t m_max = 0;
+    long double m_sum = 0.0L;
+    long double m_sumSquares = 0.0L;
+};
+
+#endif // LATENCY_HISTOGRAM_H
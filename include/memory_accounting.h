@@ -0,0 +1,89 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 分阶段内存统计 ====================
+//
+// 两个来源：
+//   1. Mat 像素内存：安装计数用的 cv::MatAllocator（包装 OpenCV 默认分配器）
+//   2. 其余堆内存：全局 operator new/delete 挂钩（CMake 选项 TABLEWARE_MEMORY_HOOKS）
+// 每次分配记到当前线程所处的阶段（MemoryStageScope），峰值为该阶段运行期间
+// 进程内被统计内存（Mat + 堆）的最大驻留量。
+// OpenCV 内部通过 fastMalloc 申请的临时缓冲不经过以上两处，不在统计范围内。
+
+enum class MemoryStage
+{
+    Other = 0,   // 不属于任何检测阶段
+    Decode,      // 图像解码
+    Resize,      // 缩放
+    HsvMask,     // HSV二值化
+    Morphology,  // 形态学处理
+    ContourFill, // 轮廓填充
+    CcFilter,    // 连通域过滤
+    Matching,    // 模板匹配
+    Count
+};
+
+// 阶段名（用于报告和基线文件）
+const char *memoryStageName(MemoryStage stage);
+
+// 单个阶段的统计
+struct MemoryStageStats
+{
+    uint64_t matBytes = 0;   // Mat 像素分配字节数
+    uint64_t matCount = 0;   // Mat 像素分配次数
+    uint64_t heapBytes = 0;  // new 分配字节数
+    uint64_t heapCount = 0;  // new 分配次数
+    uint64_t peakBytes = 0;  // 阶段运行期间的最大驻留字节数
+};
+
+// 开始统计：安装计数分配器并打开 new/delete 计数，清零所有阶段
+void enableMemoryAccounting();
+
+// 停止统计并恢复 OpenCV 默认分配器（已分配的 Mat 仍可正常释放）
+void disableMemoryAccounting();
+
+// new/delete 挂钩是否已编译进程序
+bool memoryHooksCompiledIn();
+
+// 读取所有阶段的统计快照（下标为 MemoryStage）
+vector<MemoryStageStats> memoryStageSnapshot();
+
+// 当前线程所处的阶段（RAII，离开作用域恢复上一个阶段）
+class MemoryStageScope
+{
+public:
+    explicit MemoryStageScope(MemoryStage stage);
+    ~MemoryStageScope();
+
+    MemoryStageScope(const MemoryStageScope &) = delete;
+    MemoryStageScope &operator=(const MemoryStageScope &) = delete;
+
+private:
+    MemoryStage m_previous;
+};
+
+/**
+ * @brief 输出每个阶段的统计表（按帧平均），并与基线比较
+ *
+ * 基线文件不存在时把本次结果写为基线；存在时逐阶段比较每帧分配字节数、
+ * 分配次数和峰值，超过基线 (1 + tolerance) 倍的项标记为 REGRESSION。
+ *
+ * @param stats 各阶段统计
+ * @param frames 处理的帧数
+ * @param baselineFile 基线文件路径（为空时只输出不比较）
+ * @param tolerance 允许的相对增长
+ * @return 没有回归返回 true
+ */
+bool reportMemoryStages(const vector<MemoryStageStats> &stats, int frames,
+                        const string &baselineFile, double tolerance);
+
+#endif // MEMORY_ACCOUNTING_H
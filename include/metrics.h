@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "image_processing.h"
+#include <functional>
+#include <string>
+
+using namespace std;
+
+// ==================== 运行指标导出 ====================
+//
+// 运维看板不再解析控制台输出：启用后（--metrics <file>）后台线程每隔
+// MetricsConfig::WRITE_INTERVAL_S 秒把指标以 Prometheus 文本格式写入本地文件
+// （先写临时文件再改名，读取方不会看到写了一半的文件），由 node_exporter 的
+// textfile collector 采集。导出内容：
+//   - 帧数、OK/NG、降级帧计数
+//   - 帧处理耗时、每个流水线阶段、每个模板匹配的延迟直方图（及 p50/p99/p99.9）
+//   - 每个模板的得分分布和通过/未通过计数
+//
+// 记录路径无锁：每个线程写自己的分片（只有一个写者的原子变量），导出线程读取并汇总所有分片。
+// 延迟直方图与 LatencyHistogram 使用相同的对数-线性分桶，导出时折算到 Prometheus 的 le 边界。
+
+/**
+ * @brief 启动指标导出
+ * @param path 指标文件（建议 .prom 扩展名）
+ * @param intervalS 写入间隔（秒）
+ */
+bool startMetricsExport(const string &path, double intervalS);
+
+// 停止导出线程并写入最终值（未启动时无操作）
+void stopMetricsExport();
+
+bool metricsEnabled();
+
+/**
+ * @brief 记录一帧（调用线程写自己的分片；未启用时直接返回）
+ * @param result 流水线输出（判定、降级标志、阶段耗时、各模板得分与耗时）
+ * @param frameMs 帧处理耗时（毫秒）
+ */
+void recordFrameMetrics(const DetectionPipelineResult &result, double frameMs);
+
+/**
+ * @brief 登记一个由其他模块维护、导出时读取的值（例如证据队列深度、丢弃计数）
+ * @param name 指标名
+ * @param type "gauge" 或 "counter"
+ * @param read 在导出线程中调用，必须线程安全；stopMetricsExport 之后不再调用
+ */
+void registerMetricsValue(const string &name, const string &type, const string &help, function<double()> read);
+
+#endif // METRICS_H
@@ -0,0 +1,39 @@
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// 基于图像矩（二阶中心矩，等价于像素坐标PCA）的方向估计
+//
+// 主轴角度 axisAngle 定义为 0.5 * atan2(2*mu11, mu20 - mu02)，单位为度，
+// 在图像坐标系（y轴向下）中从 x 轴量起，范围 (-90, 90]。
+// 竖直的筷子约为 ±90°，水平的约为 0°。
+
+struct BlobOrientation
+{
+    Rect bbox;              // 外接矩形
+    int area = 0;           // 像素面积
+    double axisAngle = 0.0; // 主轴角度（度）
+    double elongation = 0.0; // 长短轴之比 sqrt(λ1/λ2)，越大越细长
+    double majorLength = 0.0; // 主轴等效长度 4*sqrt(λ1)
+};
+
+// 由图像矩计算方向（m00 为 0 时返回默认值）
+BlobOrientation orientationFromMoments(const Moments &m);
+
+// 对二值图中每个连通域估计方向
+vector<BlobOrientation> estimateBlobOrientations(const Mat &binaryMask);
+
+/**
+ * @brief 由连通域主轴和模板主轴预测模板需要的旋转角度
+ *
+ * 与 getRotationMatrix2D 约定一致（正值为逆时针），模板旋转 a 度后主轴角度减少 a，
+ * 因此预测值为 templateAxis - blobAxis，归一化到 (-90, 90]。
+ */
+double predictRotationAngle(double blobAxisAngle, double templateAxisAngle);
+
+#endif // ORIENTATION_H
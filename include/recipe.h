@@ -0,0 +1,89 @@
+#ifndef RECIPE_H
+#define RECIPE_H
+
+#include "template_bank.h"
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// ==================== 产品配方 ====================
+//
+// 一条产线在一个班次内会切换多种餐具，每种产品需要不同的模板、阈值和 HSV 范围。
+// 配方文件（RecipeConfig::RECIPE_FILE）中每个 [配方名] 段描述一种产品：
+//
+//     [bowl_a]
+//     template_folder = image_samples/2/muban
+//     template_bank   = image_samples/2/muban.bank
+//     thresholds      = 0.85, 0.85
+//     hsv             = 10 25 50 250 0 255     # H最小 H最大 S最小 S最大 V最小 V最大，可写多行
+//     hsv             = 0 180 0 90 0 60
+//
+// 未写的项使用 config_constants.h 中的默认值；配方文件不存在时只有一个 default 配方。
+// 启动时所有配方的模板库一次性准备好常驻内存，换产时只切换活动配方下标，
+// 不重新加载、不重新构建，下一帧立即生效。
+
+// 单个 HSV 颜色范围
+struct HsvRange
+{
+    int hueMin = 0;
+    int hueMax = 180;
+    int satMin = 0;
+    int satMax = 255;
+    int valMin = 0;
+    int valMax = 255;
+};
+
+// config_constants.h 中的默认 HSV 范围
+const vector<HsvRange> &defaultHsvRanges();
+
+struct Recipe
+{
+    string name;
+    string templateFolder;      // 模板文件夹
+    string templateBankFile;    // 预编译模板库（存在时 mmap 加载）
+    vector<double> thresholds;  // 每个模板的阈值（按文件名顺序）
+    vector<HsvRange> hsvRanges; // HSV 二值化范围
+    TemplateBank bank;          // 启动时准备好的模板库
+};
+
+/**
+ * @brief 读取配方定义（不准备模板库）
+ * @param path 配方文件；不存在时返回一个由 config_constants.h 构成的 default 配方
+ * @param recipes 输出：配方列表（bank 为空）
+ */
+bool readRecipeDefinitions(const string &path, vector<Recipe> &recipes);
+
+class RecipeSet
+{
+public:
+    /**
+     * @brief 读取配方文件并准备所有配方的模板库
+     * @param path 配方文件；不存在时使用 config_constants.h 构成的 default 配方
+     * @return 全部配方准备成功返回 true（第一个配方为初始活动配方）
+     */
+    bool load(const string &path);
+
+    /**
+     * @brief 切换活动配方（O(1)，任何线程均可调用，从下一帧开始生效）
+     * @return 配方不存在时返回 false，活动配方不变
+     */
+    bool select(const string &name);
+
+    // 当前活动配方（每帧开始时取一次，整帧使用同一配方）
+    const Recipe &active() const { return m_recipes[m_active.load(memory_order_acquire)]; }
+
+    // 按名字查找（不存在返回 nullptr）
+    const Recipe *find(const string &name) const;
+
+    const vector<Recipe> &recipes() const { return m_recipes; }
+
+private:
+    vector<Recipe> m_recipes; // 加载后不再修改，可被多个线程同时读取
+    unordered_map<string, size_t> m_index;
+    atomic<size_t> m_active{0};
+};
+
+#endif // RECIPE_H
@@ -0,0 +1,72 @@
+#ifndef SCORE_STORE_H
+#define SCORE_STORE_H
+
+#include "image_processing.h"
+#include "template_bank.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ==================== 模板匹配得分库 ====================
+//
+// 批量检测时把每张图、每个模板、每个角度的相似度追加写入二进制文件，
+// 之后修改阈值只需读取得分库重新判定（rejudge），不必重新跑流水线。
+//
+// 文件结构（生成机器的本地字节序，文件头记录字节序标记，不一致时拒绝读取）：
+//   文件头：magic "TWSS"、字节序标记 0x01020304、版本、模板数；每个模板：文件名[128]、角度数、角度列表(float)
+//   记录：  记录标记、图片名长度、实时判定、图片名、所有模板所有角度的相似度(float，未测试为NaN)
+// 记录定长部分只取决于文件头，进程中断时末尾不完整的记录在读取时被忽略。
+
+// 得分库的模板/角度结构（写入时取自模板库）
+struct ScoreStoreSchema
+{
+    vector<string> templates;      // 模板文件名
+    vector<vector<float>> angles;  // 每个模板的角度列表（与模板库变体顺序一致）
+};
+
+// 单张图片的得分
+struct ScoreRecord
+{
+    string imageName;
+    bool liveOK = false;              // 记录时的实时判定
+    vector<vector<float>> angleScores; // [模板][角度] 相似度，未测试为 NaN
+};
+
+class ScoreStoreWriter
+{
+public:
+    /**
+     * @brief 打开得分库用于追加；文件不存在时创建并写入文件头
+     *
+     * 已存在的文件必须与当前模板库的模板和角度一致，否则拒绝追加（避免混入不可比的得分）。
+     */
+    bool open(const string &path, const TemplateBank &bank);
+
+    // 追加一条记录（立即刷新到磁盘）
+    bool append(const string &imageName, const vector<TemplateMatchResult> &results, bool liveOK);
+
+    void close();
+
+    uint64_t appended() const { return m_appended; }
+
+private:
+    ofstream m_file;
+    ScoreStoreSchema m_schema;
+    uint64_t m_appended = 0;
+};
+
+// 读取整个得分库
+bool loadScoreStore(const string &path, ScoreStoreSchema &schema, vector<ScoreRecord> &records);
+
+/**
+ * @brief 用新阈值重新判定得分库中的所有图片
+ * @param storePath 得分库文件
+ * @param labelsPath 标注文件（每行 "<图片名> OK|NG"，逗号或空白分隔；为空时不计算混淆矩阵）
+ * @param thresholds 每个模板的阈值（只给一个值时用于所有模板）
+ * @return 成功返回 true
+ */
+bool rejudgeScoreStore(const string &storePath, const string &labelsPath, const vector<double> &thresholds);
+
+#endif // SCORE_STORE_H
@@ -0,0 +1,57 @@
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// 按 alignment 向上对齐（帧环槽位、模板库像素数据等映射区域内的布局）
+inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief 内存映射区域（命名共享内存 / 只读文件映射）
+ *
+ * Linux 使用 shm_open + mmap，Windows 使用 CreateFileMapping + MapViewOfFile。
+ * 析构时自动解除映射；创建者（owner）析构时同时删除共享内存名称。
+ */
+class MappedRegion
+{
+public:
+    MappedRegion() = default;
+    ~MappedRegion();
+
+    MappedRegion(const MappedRegion &) = delete;
+    MappedRegion &operator=(const MappedRegion &) = delete;
+
+    // 创建命名共享内存（已存在则重建），大小为 size 字节
+    bool createShared(const string &name, size_t size);
+
+    // 打开已存在的命名共享内存（读写）
+    bool openShared(const string &name);
+
+    // 只读映射整个文件
+    bool mapFileReadOnly(const string &path);
+
+    // 解除映射
+    void release();
+
+    void *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool valid() const { return m_data != nullptr; }
+
+private:
+    void *m_data = nullptr;
+    size_t m_size = 0;
+    string m_sharedName; // 仅创建者记录，用于析构时删除
+#ifdef _WIN32
+    void *m_mappingHandle = nullptr;
+    void *m_fileHandle = nullptr;
+#endif
+};
+
+#endif // SHARED_MEMORY_H
@@ -0,0 +1,132 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include "orientation.h"
+#include "memory_accounting.h"
+#include "recipe.h"
+#include "config_constants.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 声明式处理流水线 ====================
+//
+// 流水线由配置中的节点列表描述，每行一个节点：
+//     <输出名> = <阶段名>(<输入名>, ...)
+// "input" 为原始BGR图像，其余输入必须是前面节点的输出（声明顺序即执行顺序）。
+//
+// 编译（compile）时根据需要的输出做裁剪和优化：
+//   - 输出没人使用的节点直接跳过（无界面运行时不再保留中间显示图）
+//   - 中间结果在最后一个使用者执行后立即释放
+//   - 相邻的逐像素阶段融合为一次逐行遍历，中间结果只占一行缓冲
+// 执行时对每个节点（或融合组）计时。
+
+// 单次执行的附加输入/输出
+struct StageContext
+{
+    // 输入：解码信息（由 resize 阶段使用）
+    int exifOrientation = 1; // 输入图像尚未应用的 EXIF 方向
+    Size sourceSize;         // 原始分辨率（输入为缩小解码时用于计算缩放目标）；为空表示与输入一致
+
+    // 输入：本帧使用的配方（HSV 范围等）；为空时使用 config_constants.h 的默认值
+    const Recipe *recipe = nullptr;
+
+    // 输入：resize 阶段的缩放比例（延迟预算降级时更粗）
+    double resizeScale = Config::RESIZE_SCALE;
+
+    // 输出
+    vector<BlobOrientation> components;   // cc_filter 保留下来的连通域统计
+    Mat componentsImage;                  // components 对应的图（cc_filter 的输出，未执行 cc_filter 时为空）
+    vector<pair<string, double>> stageMs; // 本帧每个计划步骤的耗时（按执行顺序）
+};
+
+// 阶段定义（按名字注册）
+struct StageDefinition
+{
+    string name;                               // 阶段名（配置中引用）
+    int inputCount = 1;                        // 输入个数
+    MemoryStage memoryStage = MemoryStage::Other; // 内存统计归属阶段
+
+    // 整图处理函数（非逐像素阶段）
+    function<Mat(const vector<Mat> &inputs, StageContext &context)> run;
+
+    // 逐行处理函数（逐像素阶段，只有一个输入）：处理一行 1xW 图像，写入 outRow
+    function<void(const Mat &inRow, Mat &outRow, const StageContext &context)> rowKernel;
+    int rowOutputType = -1; // 逐像素阶段的输出类型（如 CV_8UC1）
+
+    bool isPerPixel() const { return static_cast<bool>(rowKernel); }
+};
+
+// 注册阶段（同名覆盖）；内置阶段在第一次查找时自动注册
+void registerStage(const StageDefinition &definition);
+
+// 按名字查找阶段（不存在返回 nullptr）
+const StageDefinition *findStage(const string &name);
+
+// 所有已注册阶段名（用于报错提示）
+vector<string> registeredStageNames();
+
+class StageGraph
+{
+public:
+    // 解析节点列表（空行和 # 开头的行忽略）
+    bool load(const vector<string> &lines);
+
+    /**
+     * @brief 生成执行计划：裁剪无用节点、计算释放时机、融合逐像素阶段
+     * @param requiredOutputs 需要的输出；不存在的名字会被忽略，但至少要有一个存在
+     */
+    bool compile(const vector<string> &requiredOutputs);
+
+    /**
+     * @brief 执行一帧
+     * @param input 原始BGR图像
+     * @param context 附加输出
+     * @param outputs 输出：需要的输出名 → 图像
+     */
+    bool execute(const Mat &input, StageContext &context, map<string, Mat> &outputs);
+
+    // 执行计划的文字描述
+    string describe() const;
+
+    // 输出每个计划步骤的平均耗时
+    void printTimings() const;
+
+    // 是否声明了名为 name 的输出
+    bool hasOutput(const string &name) const;
+
+private:
+    struct Node
+    {
+        string output;
+        string stage;
+        vector<string> inputs;
+        const StageDefinition *definition = nullptr;
+    };
+
+    // 执行计划中的一步：单个节点或一组融合的逐像素节点
+    struct Step
+    {
+        vector<int> nodes;           // 节点下标（融合组内按执行顺序）
+        vector<string> releaseAfter; // 本步执行后可以释放的中间结果
+        string label;
+        uint64_t calls = 0;
+        double totalMs = 0.0;
+    };
+
+    bool runFusedStep(const Step &step, const StageContext &context, map<string, Mat> &slots);
+
+    vector<Node> m_nodes;
+    vector<Step> m_steps;
+    vector<string> m_required;
+    vector<string> m_skipped;
+    bool m_compiled = false;
+};
+
+#endif // STAGE_GRAPH_H
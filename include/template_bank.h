@@ -0,0 +1,89 @@
+#ifndef TEMPLATE_BANK_H
+#define TEMPLATE_BANK_H
+
+#include "shared_memory.h"
+#include "orientation.h"
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 模板库 ====================
+//
+// 模板库 = 每个模板的阈值 + 灰度模板 + 所有预旋转角度的模板 + 预计算统计量。
+// 可以从模板文件夹现场构建，也可以由 compile-templates 预编译成二进制文件，
+// 启动时直接 mmap，跳过目录遍历、JPEG解码和旋转。
+
+// 单个角度的模板
+struct TemplateVariant
+{
+    double angle = 0.0;   // 旋转角度（度）
+    Mat image;            // 旋转后的模板（CV_8UC1）
+    int whitePixels = 0;  // 非零像素数
+    double energy = 0.0;  // 像素平方和 Σ T(x,y)^2
+};
+
+// 单个模板及其全部旋转版本
+struct TemplateEntry
+{
+    string filename;                 // 模板文件名
+    double threshold = 0.0;          // 匹配阈值
+    BlobOrientation orientation;     // 0° 模板的主轴方向（用于预测旋转角度）
+    vector<TemplateVariant> variants; // 按角度测试顺序排列，variants[0] 为 0° 原图；加载失败时为空
+    uint64_t sourceSize = 0;         // 源文件大小（字节），用于判断预编译模板库是否过期
+    int64_t sourceMtime = 0;         // 源文件修改时间（文件系统时钟计数）
+};
+
+struct TemplateBank
+{
+    vector<TemplateEntry> templates;  // 按文件名排序
+    double rotationMax = 0.0;         // 构建时的角度范围
+    double rotationStep = 0.0;        // 构建时的角度步长
+    shared_ptr<MappedRegion> mapping; // 从文件加载时，模板像素直接指向该映射
+};
+
+// 构建角度测试序列（中心扩散）：0, +step, -step, +2*step, -2*step, ...
+vector<double> buildAngleSequence(double rotationMax, double rotationStep);
+
+/**
+ * @brief 从模板文件夹构建模板库（遍历、解码、旋转、统计）
+ * @param templateFolder 模板文件夹路径
+ * @param thresholds 每个模板的阈值（按文件名顺序）
+ * @param bank 输出：模板库
+ * @return 成功返回 true
+ */
+bool buildTemplateBank(const string &templateFolder, const vector<double> &thresholds, TemplateBank &bank);
+
+// 将模板库写入版本化二进制文件
+bool saveTemplateBank(const TemplateBank &bank, const string &path);
+
+// mmap 加载预编译的模板库文件（模板像素不拷贝）
+bool loadTemplateBank(const string &path, TemplateBank &bank);
+
+/**
+ * @brief 核对预编译模板库是否与模板文件夹一致（compile-templates 用来跳过不必要的重新编译）
+ *
+ * 模板库记录了每个源模板的文件名、大小和修改时间以及角度配置；增删或修改了模板、改了角度配置
+ * 都视为过期。阈值以配方为准，不参与核对。
+ * @param reason 输出：不一致的原因
+ * @return 模板库存在、可加载且与模板文件夹一致时返回 true
+ */
+bool templateBankUpToDate(const string &bankFile, const string &templateFolder, string &reason);
+
+/**
+ * @brief 启动时准备模板库：优先加载预编译文件，不存在或不可用时回退到扫描模板文件夹
+ *
+ * 只 mmap 并校验版本和文件大小，不遍历模板文件夹、不改写模板库文件；模板修改后由
+ * compile-templates（test.bat 会自动执行）重新编译。
+ * @param bankFile 预编译模板库文件路径
+ * @param templateFolder 模板文件夹路径
+ * @param thresholds 回退扫描时使用的阈值
+ * @param bank 输出：模板库
+ */
+bool prepareTemplateBank(const string &bankFile, const string &templateFolder,
+                         const vector<double> &thresholds, TemplateBank &bank);
+
+#endif // TEMPLATE_BANK_H
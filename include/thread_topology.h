@@ -0,0 +1,100 @@
+#ifndef THREAD_TOPOLOGY_H
+#define THREAD_TOPOLOGY_H
+
+#include "config_constants.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ==================== 工作线程拓扑 ====================
+//
+// 多个检测工作线程并行时，每次 OpenCV 调用还会再启动自己的内部线程；在约 150x200 的
+// 掩码上这会让 CPU 超额订阅、拉长尾延迟。这里统一配置：
+//   - 工作线程数（--workers N，批量模式）
+//   - 每个工作线程的 OpenCV 线程数（--cv-threads T，调用 cv::setNumThreads）
+//   - 工作线程绑定（--affinity none | cores | numa | CPU列表，如 0-3,8）
+// 并在结束时按工作线程输出上下文切换次数、CPU 时间和运行队列等待时间，
+// 用于在不同机器上比较 workers × threads 的布局。
+//
+// 注意：OpenCV 默认并行后端（pthreads/TBB/Concurrency）的线程数是进程级设置，
+// 各工作线程设置的是同一个值；OpenMP 后端下该设置按调用线程生效。
+// 多个工作线程时通常应使用 --cv-threads 1。
+
+enum class AffinityMode
+{
+    None,      // 不绑定
+    Cores,     // 每个工作线程独占连续的 max(1, T) 个逻辑核
+    NumaNodes, // 工作线程轮流绑定到各 NUMA 节点的全部核
+    CpuList    // 所有工作线程共用指定的 CPU 集合
+};
+
+struct ThreadTopology
+{
+    int workers = ThreadTopologyConfig::DEFAULT_WORKERS;      // 工作线程数
+    int cvThreads = ThreadTopologyConfig::DEFAULT_CV_THREADS; // 每个工作线程的 OpenCV 线程数（<0 保持 OpenCV 默认）
+    AffinityMode affinity = AffinityMode::None;               // 绑定方式
+    vector<int> cpuList;                                      // CpuList 模式的 CPU 集合
+};
+
+/**
+ * @brief 解析 --affinity 参数
+ * @param spec none / cores / numa / CPU列表（如 "0-3,8,10-11"）
+ */
+bool parseAffinitySpec(const string &spec, ThreadTopology &topology);
+
+// 输出拓扑配置；工作线程数 × OpenCV 线程数超过逻辑核数时给出超额订阅警告
+void printTopologyPlan(const ThreadTopology &topology);
+
+/**
+ * @brief 检查绑定方式与 OpenCV 线程池是否冲突
+ *
+ * 进程级线程池（非 OpenMP 后端）只创建一次，池中线程继承首次并行调用的工作线程的绑定。
+ * cores 模式下多个工作线程且每个工作线程多于 1 个 OpenCV 线程时，所有工作线程的并行部分都会
+ * 挤在 0 号工作线程独占的核上，拒绝运行；numa 模式下只会挤在一个节点上，给出警告。
+ * @return 配置可用返回 true
+ */
+bool checkTopology(const ThreadTopology &topology);
+
+// 第 workerIndex 个工作线程应绑定的 CPU 集合（空表示不绑定）
+vector<int> workerCpuSet(const ThreadTopology &topology, int workerIndex);
+
+// 把当前线程绑定到指定 CPU 集合（平台不支持或失败时输出警告并返回 false）
+bool pinCurrentThread(const vector<int> &cpus);
+
+/**
+ * @brief 在工作线程开始时调用：设置 OpenCV 线程数并绑定 CPU
+ * @return 实际绑定的 CPU 集合（未绑定时为空）
+ */
+vector<int> applyWorkerTopology(const ThreadTopology &topology, int workerIndex);
+
+// 线程调度统计采样（累计值，两次采样相减得到区间内的值）
+struct ThreadSchedSample
+{
+    bool switchesAvailable = false;   // 平台是否提供线程级上下文切换次数
+    bool runQueueAvailable = false;   // 平台是否提供线程级运行队列等待时间
+    uint64_t voluntarySwitches = 0;   // 主动让出 CPU（等待 I/O、锁等）
+    uint64_t involuntarySwitches = 0; // 被抢占（时间片用完或有更高优先级线程）
+    double cpuMs = 0.0;               // 线程 CPU 时间
+    double runQueueWaitMs = 0.0;      // 就绪但在运行队列中等待 CPU 的时间
+    double wallMs = 0.0;              // steady_clock 时刻（毫秒）
+};
+
+// 采样当前线程（必须在被统计的线程中调用）
+ThreadSchedSample sampleCurrentThread();
+
+// 单个工作线程的统计
+struct WorkerSchedReport
+{
+    int worker = 0;
+    vector<int> cpus;       // 绑定的 CPU（空表示未绑定）
+    uint64_t frames = 0;    // 处理的帧数
+    ThreadSchedSample start;
+    ThreadSchedSample end;
+};
+
+// 输出各工作线程的上下文切换、CPU 时间和运行队列等待
+void printWorkerSchedReports(const ThreadTopology &topology, const vector<WorkerSchedReport> &reports);
+
+#endif // THREAD_TOPOLOGY_H
@@ -0,0 +1,98 @@
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include "image_processing.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// ==================== 检测结果查看器 ====================
+//
+// 显示在独立线程中进行，不占用检测路径：
+//   检测线程 --post()--> FrameMailbox（只保留最新一帧） --> 查看器线程渲染
+// 查看器渲染跟不上时，旧帧直接被新帧覆盖，检测线程不会因为显示而等待。
+
+// 检测线程交给查看器的一帧（Mat 只共享引用计数，不拷贝像素）
+struct ViewerFrame
+{
+    string name;                              // 图片名或帧序号
+    vector<Mat> panels;                       // 6张处理步骤图（原图、缩放、二值、形态学、轮廓填充、最终结果）
+    vector<TemplateMatchResult> matchResults; // 每个模板的匹配结果
+    bool isOK = false;                        // 最终判定
+    int algorithmMs = 0;                      // 算法耗时
+    int totalMs = 0;                          // 总耗时
+};
+
+// 单槽邮箱：新帧覆盖未取走的旧帧（latest-frame-wins）
+class FrameMailbox
+{
+public:
+    // 放入一帧；若上一帧尚未被取走则丢弃它
+    void post(shared_ptr<ViewerFrame> frame);
+
+    // 取走最新一帧（没有新帧时返回空指针）
+    shared_ptr<ViewerFrame> take();
+
+    // 被覆盖（未显示）的帧数
+    uint64_t overwritten() const { return m_overwritten.load(); }
+
+private:
+    mutex m_mutex;
+    shared_ptr<ViewerFrame> m_latest;
+    atomic<uint64_t> m_overwritten{0};
+};
+
+class DetectionViewer
+{
+public:
+    DetectionViewer() = default;
+    ~DetectionViewer();
+
+    DetectionViewer(const DetectionViewer &) = delete;
+    DetectionViewer &operator=(const DetectionViewer &) = delete;
+
+    // 启动查看器线程
+    void start(const string &windowName);
+
+    // 提交一帧（检测线程调用，不阻塞）
+    void post(shared_ptr<ViewerFrame> frame);
+
+    // 显示完最后一帧后停止查看器线程；waitForClose 为 true 时等待用户按键关闭窗口
+    void stop(bool waitForClose = false);
+
+    // 查看器是否仍在运行（用户按 ESC 关闭窗口后为 false）
+    bool running() const { return m_running.load(); }
+
+    uint64_t renderedFrames() const { return m_rendered.load(); }
+    uint64_t skippedFrames() const { return m_mailbox.overwritten(); }
+
+private:
+    void run();
+    void render(const ViewerFrame &frame);
+    void onMouseMove(int x, int y);
+    static void mouseCallback(int event, int x, int y, int flags, void *userdata);
+
+    string m_windowName;
+    FrameMailbox m_mailbox;
+    thread m_thread;
+    atomic<bool> m_running{false};
+    atomic<bool> m_stopRequested{false};
+    atomic<bool> m_waitForClose{false};
+    atomic<uint64_t> m_rendered{0};
+
+    // 以下成员只在查看器线程中访问（鼠标回调也在该线程的 waitKey 内触发）
+    Mat m_baseCanvas;    // 完整渲染结果（不含鼠标叠加层）
+    Mat m_displayCanvas; // 实际显示的画布 = 基础画布 + 十字标记 + 像素信息
+    Rect m_crosshairRect; // 上一次十字标记覆盖的区域
+    Rect m_overlayRect;   // 像素信息叠加层区域
+};
+
+#endif // VIEWER_H
@@ -0,0 +1,157 @@
+/*
+ * 有界 SQDIFF 匹配 - 积分图下界剪枝 + 逐行部分和提前放弃，找到通过位置即停止
+ */
+
+#include "bounded_match.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+// 下界比较的相对余量，避免浮点舍入把恰好等于界限的位置误排除
+static const double BOUND_SLACK = 1e-9;
+
+// 积分图上矩形区域的和
+static inline double rectSum(const Mat &integralImage, int x, int y, int width, int height)
+{
+    const double *top = integralImage.ptr<double>(y);
+    const double *bottom = integralImage.ptr<double>(y + height);
+    return bottom[x + width] - bottom[x] - top[x + width] + top[x];
+}
+
+// 由像素和与能量得到的平方差下界
+static inline double ssdLowerBound(double imageEnergy, double imageSum,
+                                   double templEnergy, double templSum, int count)
+{
+    double energyGap = sqrt(max(imageEnergy, 0.0)) - sqrt(templEnergy);
+    double bound = energyGap * energyGap;
+    if (count > 0)
+    {
+        double sumGap = imageSum - templSum;
+        bound = max(bound, sumGap * sumGap / count);
+    }
+    return bound;
+}
+
+BoundedSqdiffMatcher::BoundedSqdiffMatcher(const Mat &image)
+    : m_image(image)
+{
+    integral(image, m_sum, m_sqsum, CV_64F, CV_64F);
+}
+
+bool BoundedSqdiffMatcher::match(const Mat &templ, const Rect &searchArea, double passValue,
+                                 double &bestValue, BoundedMatchStats &stats) const
+{
+    Rect area = searchArea & Rect(0, 0, m_image.cols, m_image.rows);
+    const int templWidth = templ.cols;
+    const int templHeight = templ.rows;
+    if (area.width < templWidth || area.height < templHeight || templ.empty())
+    {
+        return false;
+    }
+
+    // 模板从第 r 行到末尾的能量和像素和（逐行放弃时作为剩余部分的下界）
+    vector<double> suffixEnergy(templHeight + 1, 0.0);
+    vector<double> suffixSum(templHeight + 1, 0.0);
+    for (int r = templHeight - 1; r >= 0; r--)
+    {
+        const uchar *row = templ.ptr<uchar>(r);
+        double rowEnergy = 0.0;
+        double rowSum = 0.0;
+        for (int c = 0; c < templWidth; c++)
+        {
+            rowEnergy += double(row[c]) * row[c];
+            rowSum += row[c];
+        }
+        suffixEnergy[r] = suffixEnergy[r + 1] + rowEnergy;
+        suffixSum[r] = suffixSum[r + 1] + rowSum;
+    }
+
+    const double templEnergy = suffixEnergy[0];
+    const double templSum = suffixSum[0];
+    if (templEnergy <= 0.0)
+    {
+        return false; // 全黑模板：归一化平方差恒为1
+    }
+
+    const int count = templWidth * templHeight;
+    const int lastX = area.x + area.width - templWidth;
+    const int lastY = area.y + area.height - templHeight;
+
+    for (int y = area.y; y <= lastY; y++)
+    {
+        for (int x = area.x; x <= lastX; x++)
+        {
+            stats.positions++;
+
+            double imageEnergy = rectSum(m_sqsum, x, y, templWidth, templHeight);
+            if (imageEnergy <= 0.0)
+            {
+                stats.empty++;
+                continue;
+            }
+
+            // 只有可能优于当前最小值或达到通过界限的位置才值得计算
+            double norm = sqrt(imageEnergy * templEnergy);
+            double limit = max(bestValue, passValue) * norm * (1.0 + BOUND_SLACK);
+
+            double imageSum = rectSum(m_sum, x, y, templWidth, templHeight);
+            if (ssdLowerBound(imageEnergy, imageSum, templEnergy, templSum, count) > limit)
+            {
+                stats.pruned++;
+                continue;
+            }
+
+            // 逐行累加平方差，已累加部分 + 剩余行下界超过界限时放弃
+            double ssd = 0.0;
+            bool abandoned = false;
+            for (int r = 0; r < templHeight; r++)
+            {
+                const uchar *imageRow = m_image.ptr<uchar>(y + r) + x;
+                const uchar *templRow = templ.ptr<uchar>(r);
+                int64_t rowSsd = 0;
+                for (int c = 0; c < templWidth; c++)
+                {
+                    int diff = int(imageRow[c]) - int(templRow[c]);
+                    rowSsd += diff * diff;
+                }
+                ssd += double(rowSsd);
+
+                int remainingRows = templHeight - r - 1;
+                double remainingBound = 0.0;
+                if (remainingRows > 0)
+                {
+                    remainingBound = ssdLowerBound(rectSum(m_sqsum, x, y + r + 1, templWidth, remainingRows),
+                                                   rectSum(m_sum, x, y + r + 1, templWidth, remainingRows),
+                                                   suffixEnergy[r + 1], suffixSum[r + 1],
+                                                   remainingRows * templWidth);
+                }
+                if (ssd + remainingBound > limit)
+                {
+                    abandoned = true;
+                    break;
+                }
+            }
+            if (abandoned)
+            {
+                stats.abandoned++;
+                continue;
+            }
+
+            stats.evaluated++;
+            double value = ssd / norm;
+            if (value < bestValue)
+            {
+                bestValue = value;
+            }
+            if (value <= passValue)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -6,6 +6,8 @@
 #include "image_processing.h"
 #include "config_constants.h"
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 
 using namespace cv;
 using namespace std;
@@ -14,19 +16,37 @@ using namespace std;
 Mat g_hsvImage;
 Mat g_originalImage;
 
+// 扩展画布底部信息区高度
+static const int INFO_AREA_HEIGHT = 60;
+
+// 重绘扩展画布底部的信息区
+static void drawInfoArea(Mat &canvas, int imageRows, const string &text1, const string &text2, const string &text3)
+{
+    rectangle(canvas, Point(0, imageRows), Point(canvas.cols, imageRows + INFO_AREA_HEIGHT), Scalar(40, 40, 40), -1);
+    putText(canvas, text1, Point(10, imageRows + 15), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
+    putText(canvas, text2, Point(10, imageRows + 30), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
+    putText(canvas, text3, Point(10, imageRows + 45), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
+}
+
 // 创建扩展画布的辅助函数
 Mat createExtendedCanvas(const Mat &image, const string &text1, const string &text2, const string &text3)
 {
-    const int infoHeight = 60;
-    Mat canvas = Mat::zeros(image.rows + infoHeight, image.cols, CV_8UC3);
+    Mat canvas = Mat::zeros(image.rows + INFO_AREA_HEIGHT, image.cols, CV_8UC3);
     image.copyTo(canvas(Rect(0, 0, image.cols, image.rows)));
-    rectangle(canvas, Point(0, image.rows), Point(image.cols, image.rows + infoHeight), Scalar(40, 40, 40), -1);
-    putText(canvas, text1, Point(10, image.rows + 15), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
-    putText(canvas, text2, Point(10, image.rows + 30), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
-    putText(canvas, text3, Point(10, image.rows + 45), FONT_HERSHEY_SIMPLEX, 0.4, Scalar(0, 255, 255), 1);
+    drawInfoArea(canvas, image.rows, text1, text2, text3);
     return canvas;
 }
 
+// 颜色分析窗口的显示画布（只在鼠标移动时局部重绘）
+static Mat g_analysisCanvas;
+static Rect g_lastCrosshair;
+
+// 十字标记覆盖的区域（含线宽）
+static Rect crosshairRect(int x, int y, const Size &imageSize)
+{
+    return Rect(x - 11, y - 11, 23, 23) & Rect(0, 0, imageSize.width, imageSize.height);
+}
+
 // 鼠标回调函数 - 显示HSV值
 void onMouse(int event, int x, int y, int flags, void *userdata)
 {
@@ -36,10 +56,16 @@ void onMouse(int event, int x, int y, int flags, void *userdata)
         Vec3b hsvPixel = g_hsvImage.at<Vec3b>(y, x);
         Vec3b bgrPixel = g_originalImage.at<Vec3b>(y, x);
 
-        // 创建带十字标记的图像
-        Mat displayImg = g_originalImage.clone();
-        line(displayImg, Point(x - 10, y), Point(x + 10, y), Scalar(0, 255, 0), 2);
-        line(displayImg, Point(x, y - 10), Point(x, y + 10), Scalar(0, 255, 0), 2);
+        // 只恢复上一次十字标记覆盖的区域，不再整图拷贝
+        if (g_lastCrosshair.area() > 0)
+        {
+            g_originalImage(g_lastCrosshair).copyTo(g_analysisCanvas(g_lastCrosshair));
+        }
+
+        // 绘制新的十字标记
+        line(g_analysisCanvas, Point(x - 10, y), Point(x + 10, y), Scalar(0, 255, 0), 2);
+        line(g_analysisCanvas, Point(x, y - 10), Point(x, y + 10), Scalar(0, 255, 0), 2);
+        g_lastCrosshair = crosshairRect(x, y, g_originalImage.size());
 
         // 生成信息文字
         string pos = "Pos:(" + to_string(x) + "," + to_string(y) + ")";
@@ -47,28 +73,57 @@ void onMouse(int event, int x, int y, int flags, void *userdata)
         string rgb = "RGB:(" + to_string(bgrPixel[2]) + "," + to_string(bgrPixel[1]) + "," + to_string(bgrPixel[0]) +
                      ") Gray:" + to_string((int)(0.299 * bgrPixel[2] + 0.587 * bgrPixel[1] + 0.114 * bgrPixel[0]));
 
-        // 显示扩展画布
-        imshow("HSV Color Analysis - Move mouse to see values", createExtendedCanvas(displayImg, pos, hsv, rgb));
+        // 只重绘底部信息区
+        drawInfoArea(g_analysisCanvas, g_originalImage.rows, pos, hsv, rgb);
+
+        imshow("HSV Color Analysis - Move mouse to see values", g_analysisCanvas);
     }
 }
 
+// subplot布局参数
+static const int SUBPLOT_MAX_WIDTH = 300;
+static const int SUBPLOT_MAX_HEIGHT = 250;
+static const int SUBPLOT_MARGIN = 20;
+static const int SUBPLOT_TITLE_HEIGHT = 30;
+
+// 检测结果画布底部文字区域高度
+static const int RESULT_TEXT_AREA_HEIGHT = 150;
+
+// subplot画布尺寸
+static Size subplotCanvasSize(int rows, int cols)
+{
+    return Size(cols * (SUBPLOT_MAX_WIDTH + SUBPLOT_MARGIN) + SUBPLOT_MARGIN,
+                rows * (SUBPLOT_MAX_HEIGHT + SUBPLOT_MARGIN + SUBPLOT_TITLE_HEIGHT) + SUBPLOT_MARGIN);
+}
+
 // 创建subplot效果的函数（保持图像宽高比）
 Mat createSubplotDisplay(const vector<Mat> &images,
                          const vector<string> &titles,
                          int rows, int cols)
+{
+    Mat canvas;
+    renderSubplotDisplay(images, titles, rows, cols, canvas);
+    return canvas;
+}
+
+// 将subplot绘制到canvas（尺寸不变时复用canvas内存，子图直接缩放到画布区域内）
+void renderSubplotDisplay(const vector<Mat> &images,
+                          const vector<string> &titles,
+                          int rows, int cols, Mat &canvas)
 {
     // 计算每个子图区域的最大大小
-    int maxSubWidth = 300;
-    int maxSubHeight = 250;
-    int margin = 20;
-    int titleHeight = 30;
-
-    // 创建大画布
-    Mat canvas = Mat::zeros(rows * (maxSubHeight + margin + titleHeight) + margin,
-                            cols * (maxSubWidth + margin) + margin,
-                            CV_8UC3);
+    int maxSubWidth = SUBPLOT_MAX_WIDTH;
+    int maxSubHeight = SUBPLOT_MAX_HEIGHT;
+    int margin = SUBPLOT_MARGIN;
+    int titleHeight = SUBPLOT_TITLE_HEIGHT;
+
+    // 创建大画布（已有同尺寸画布时不重新分配）
+    canvas.create(subplotCanvasSize(rows, cols), CV_8UC3);
     canvas.setTo(Scalar(50, 50, 50)); // 深灰色背景
 
+    // 灰度子图缩放用的临时缓冲
+    static thread_local Mat grayScratch;
+
     for (int i = 0; i < images.size() && i < titles.size(); i++)
     {
         int row = i / cols;
@@ -79,7 +134,11 @@ Mat createSubplotDisplay(const vector<Mat> &images,
         int centerY = row * (maxSubHeight + margin + titleHeight) + margin + titleHeight + maxSubHeight / 2;
 
         // 计算保持宽高比的缩放尺寸
-        Mat currentImg = images[i];
+        const Mat &currentImg = images[i];
+        if (currentImg.empty())
+        {
+            continue;
+        }
         double aspectRatio = (double)currentImg.cols / currentImg.rows;
 
         int newWidth, newHeight;
@@ -96,16 +155,6 @@ Mat createSubplotDisplay(const vector<Mat> &images,
             newWidth = (int)(maxSubHeight * aspectRatio);
         }
 
-        // 缩放图像
-        Mat resized;
-        resize(currentImg, resized, Size(newWidth, newHeight));
-
-        // 如果是灰度图，转换为彩色
-        if (resized.channels() == 1)
-        {
-            cvtColor(resized, resized, COLOR_GRAY2BGR);
-        }
-
         // 计算实际绘制位置（居中）
         int drawX = centerX - newWidth / 2;
         int drawY = centerY - newHeight / 2;
@@ -114,8 +163,17 @@ Mat createSubplotDisplay(const vector<Mat> &images,
         drawX = max(0, min(drawX, canvas.cols - newWidth));
         drawY = max(0, min(drawY, canvas.rows - newHeight));
 
-        // 复制到画布
-        resized.copyTo(canvas(Rect(drawX, drawY, newWidth, newHeight)));
+        // 直接缩放到画布区域；灰度图先缩放再转换为彩色
+        Mat target = canvas(Rect(drawX, drawY, newWidth, newHeight));
+        if (currentImg.channels() == 1)
+        {
+            resize(currentImg, grayScratch, Size(newWidth, newHeight));
+            cvtColor(grayScratch, target, COLOR_GRAY2BGR);
+        }
+        else
+        {
+            resize(currentImg, target, Size(newWidth, newHeight));
+        }
 
         // 添加标题（在子图区域的上方）
         int titleX = col * (maxSubWidth + margin) + margin;
@@ -128,8 +186,63 @@ Mat createSubplotDisplay(const vector<Mat> &images,
         putText(canvas, sizeInfo, Point(titleX, titleY + 15),
                 FONT_HERSHEY_SIMPLEX, 0.4, Scalar(200, 200, 200), 1);
     }
+}
 
-    return canvas;
+// 绘制完整检测结果画布（尺寸不变时复用canvas内存）
+void renderDetectionCanvas(const vector<Mat> &images,
+                           const vector<string> &titles,
+                           const vector<TemplateMatchResult> &matchResults,
+                           bool isOK, int algorithmMs, int totalMs, Mat &canvas)
+{
+    // 2行3列子图 + 底部文字区域
+    Size subplotSize = subplotCanvasSize(2, 3);
+    canvas.create(subplotSize.height + RESULT_TEXT_AREA_HEIGHT, subplotSize.width, CV_8UC3);
+
+    Mat subplotArea = canvas(Rect(0, 0, subplotSize.width, subplotSize.height));
+    renderSubplotDisplay(images, titles, 2, 3, subplotArea);
+    canvas(Rect(0, subplotSize.height, subplotSize.width, RESULT_TEXT_AREA_HEIGHT)).setTo(Scalar(40, 40, 40));
+
+    // 在扩展画布左上角显示处理时间
+    putText(canvas, "Algorithm: " + to_string(algorithmMs) + "ms", Point(10, 30),
+            FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
+    putText(canvas, "Total: " + to_string(totalMs) + "ms", Point(10, 60),
+            FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
+
+    // 在扩展画布底部专门区域显示模板匹配结果
+    int textStartY = subplotSize.height + 30; // 文字起始Y坐标
+    for (size_t i = 0; i < matchResults.size(); ++i)
+    {
+        // 格式化显示：最佳相似度=X.XXX (角度=X.X°)
+        stringstream ss;
+        ss << (matchResults[i].scoreExact ? "" : ">=") << fixed << setprecision(3) << matchResults[i].score;
+        string scoreStr = ss.str();
+        ss.str("");
+        ss << fixed << setprecision(1) << matchResults[i].bestAngle;
+        string angleStr = ss.str();
+
+        string statusText = "no." + to_string(i + 1) + ":" + (matchResults[i].passed ? "ok" : "ng") +
+                            " similarity=" + scoreStr + " (angle=" + angleStr + "deg)";
+        Scalar statusColor = matchResults[i].passed ? Scalar(255, 0, 0) : Scalar(0, 0, 255); // 蓝色=OK, 红色=NG
+        putText(canvas, statusText, Point(10, textStartY + int(i * 35)),
+                FONT_HERSHEY_COMPLEX, 0.7, statusColor, 2);
+    }
+
+    // 在画布右上角显示 OK/NG 判定结果
+    string judgementText = isOK ? "OK" : "NG";
+    Scalar judgementColor = isOK ? Scalar(0, 255, 0) : Scalar(0, 0, 255); // 绿色=OK, 红色=NG
+
+    // 计算文本尺寸以便右对齐
+    int fontFace = FONT_HERSHEY_SIMPLEX;
+    double fontScale = 2.5;
+    int thickness = 5;
+    int baseline = 0;
+    Size textSize = getTextSize(judgementText, fontFace, fontScale, thickness, &baseline);
+
+    // 右上角位置（留出边距）
+    Point textPos(canvas.cols - textSize.width - 30, textSize.height + 30);
+
+    // 绘制文本
+    putText(canvas, judgementText, textPos, fontFace, fontScale, judgementColor, thickness);
 }
 
 // 显示交互式颜色分析窗口
@@ -140,6 +253,8 @@ void showColorAnalysis(const Mat &hsvImage, const Mat &originalImage)
     // 设置全局变量
     g_hsvImage = hsvImage.clone();
     g_originalImage = originalImage.clone();
+    g_analysisCanvas = createExtendedCanvas(originalImage, "", "Move mouse over image to see HSV values", "");
+    g_lastCrosshair = Rect();
 
     // 创建窗口并设置位置
     namedWindow(windowName, WINDOW_AUTOSIZE);
@@ -147,7 +262,7 @@ void showColorAnalysis(const Mat &hsvImage, const Mat &originalImage)
     setMouseCallback(windowName, onMouse, nullptr);
 
     // 显示初始画布
-    imshow(windowName, createExtendedCanvas(originalImage, "", "Move mouse over image to see HSV values", ""));
+    imshow(windowName, g_analysisCanvas);
 
     // 等待用户交互
     waitKey(0);
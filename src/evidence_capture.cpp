@@ -0,0 +1,388 @@
+/*
+ * NG 证据留存 - 有界队列 + 后台编码写盘 + 磁盘配额
+ */
+
+#include "evidence_capture.h"
+#include "config_constants.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+namespace fs = std::filesystem;
+
+shared_ptr<EvidenceFrame> makeEvidenceFrame(const string &name, const DetectionPipelineResult &result,
+                                            const TemplateBank &bank)
+{
+    auto frame = make_shared<EvidenceFrame>();
+    frame->name = name;
+    frame->capturedAt = chrono::system_clock::now();
+    frame->resized = result.resizedImage;
+    frame->mask = result.originalBinary;
+    frame->finalResult = result.finalResult;
+    frame->matchResults = result.matchResults;
+
+    // 最佳角度的模板：叠加图需要它定位最佳匹配位置（模板库可能是 mmap 的，不能只共享 Mat 头）
+    for (const TemplateMatchResult &match : result.matchResults)
+    {
+        Mat best;
+        for (const TemplateEntry &entry : bank.templates)
+        {
+            if (entry.filename != match.filename || entry.variants.empty())
+            {
+                continue;
+            }
+            const TemplateVariant *nearest = &entry.variants[0];
+            for (const TemplateVariant &variant : entry.variants)
+            {
+                if (abs(variant.angle - match.bestAngle) < abs(nearest->angle - match.bestAngle))
+                {
+                    nearest = &variant;
+                }
+            }
+            best = nearest->image.clone();
+            break;
+        }
+        frame->bestTemplates.push_back(best);
+    }
+    return frame;
+}
+
+// 目录名中只保留字母数字和 -_.，其余替换为 _
+static string sanitizeName(const string &name)
+{
+    string cleaned = name;
+    for (char &c : cleaned)
+    {
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.')
+        {
+            c = '_';
+        }
+    }
+    return cleaned;
+}
+
+// 目录名以本地时间开头（精确到毫秒），按名称排序即按时间排序
+static string evidenceDirectoryName(const EvidenceFrame &frame)
+{
+    time_t seconds = chrono::system_clock::to_time_t(frame.capturedAt);
+    int millis = int(chrono::duration_cast<chrono::milliseconds>(frame.capturedAt.time_since_epoch()).count() % 1000);
+    tm local{};
+#if defined(_WIN32)
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    ostringstream name;
+    name << put_time(&local, "%Y%m%d_%H%M%S") << "_" << setw(3) << setfill('0') << millis << "_"
+         << sanitizeName(frame.name);
+    return name.str();
+}
+
+static uint64_t directorySize(const fs::path &directory)
+{
+    uint64_t bytes = 0;
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(directory, ec))
+    {
+        if (entry.is_regular_file(ec))
+        {
+            bytes += entry.file_size(ec);
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief 最佳匹配叠加图：缩放图上按最佳角度模板的像素涂色并框出位置（通过绿色，未通过红色）
+ *
+ * 检测时的有界匹配找到通过位置即停止、不记录坐标，这里在写入线程中对 final 重新做一次
+ * 全图匹配定位，不占用检测时间。final 为空白（没有保留的连通域）或得分为 0 时没有可信的位置，
+ * 只写文字不画框（否则会在左上角画一个误导的框）。
+ */
+static Mat renderOverlay(const EvidenceFrame &frame)
+{
+    Mat overlay;
+    if (!frame.resized.empty())
+    {
+        overlay = frame.resized.clone();
+    }
+    else if (!frame.finalResult.empty())
+    {
+        cvtColor(frame.finalResult, overlay, COLOR_GRAY2BGR);
+    }
+    else
+    {
+        return overlay;
+    }
+
+    // 降级到 coarse_resize 时缩放图比 final 小，统一到 final 的坐标
+    if (!frame.finalResult.empty() && overlay.size() != frame.finalResult.size())
+    {
+        resize(overlay, overlay, frame.finalResult.size(), 0, 0, INTER_LINEAR);
+    }
+
+    bool hasComponents = !frame.finalResult.empty() && countNonZero(frame.finalResult) > 0;
+
+    int textY = 20;
+    for (size_t i = 0; i < frame.matchResults.size(); i++)
+    {
+        const TemplateMatchResult &match = frame.matchResults[i];
+        Scalar color = match.passed ? Scalar(0, 255, 0) : Scalar(0, 0, 255);
+
+        const Mat &templ = i < frame.bestTemplates.size() ? frame.bestTemplates[i] : Mat();
+        if (hasComponents && match.score > 0.0 && !templ.empty() &&
+            templ.cols <= frame.finalResult.cols && templ.rows <= frame.finalResult.rows)
+        {
+            Mat matchResult;
+            matchTemplate(frame.finalResult, templ, matchResult, TM_SQDIFF_NORMED);
+            Point minLoc;
+            minMaxLoc(matchResult, nullptr, nullptr, &minLoc, nullptr);
+
+            Rect box(minLoc.x, minLoc.y, templ.cols, templ.rows);
+            overlay(box).setTo(color, templ);
+            rectangle(overlay, box, color, 1);
+        }
+
+        ostringstream label;
+        label << match.filename << " " << (match.scoreExact ? "" : ">=") << fixed << setprecision(3) << match.score
+              << " @" << setprecision(0) << match.bestAngle << "deg";
+        putText(overlay, label.str(), Point(5, textY), FONT_HERSHEY_SIMPLEX, 0.4, color, 1, LINE_AA);
+        textY += 16;
+    }
+    putText(overlay, "NG", Point(5, overlay.rows - 8), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(0, 0, 255), 2, LINE_AA);
+    return overlay;
+}
+
+// ==================== EvidenceCapture ====================
+
+EvidenceCapture::~EvidenceCapture()
+{
+    stop();
+}
+
+bool EvidenceCapture::start(const string &folder, uint64_t quotaBytes, size_t queueCapacity)
+{
+    if (m_thread.joinable())
+    {
+        cerr << "错误: 证据留存已启动" << endl;
+        return false;
+    }
+    if (folder.empty() || quotaBytes == 0 || queueCapacity == 0)
+    {
+        cerr << "错误: 证据文件夹不能为空，配额和队列容量必须大于0" << endl;
+        return false;
+    }
+
+    // 已有的证据目录计入配额（目录名以时间开头，按名称排序即从旧到新）
+    m_stored.clear();
+    try
+    {
+        fs::create_directories(folder);
+        vector<string> existing;
+        for (const auto &entry : fs::directory_iterator(folder))
+        {
+            if (entry.is_directory())
+            {
+                existing.push_back(entry.path().string());
+            }
+        }
+        sort(existing.begin(), existing.end());
+        uint64_t bytes = 0;
+        for (const string &directory : existing)
+        {
+            m_stored.emplace_back(directory, directorySize(directory));
+            bytes += m_stored.back().second;
+        }
+        m_diskBytes = bytes;
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        cerr << "错误: 无法使用证据文件夹 " << folder << ": " << e.what() << endl;
+        return false;
+    }
+
+    m_folder = folder;
+    m_quotaBytes = quotaBytes;
+    m_capacity = queueCapacity;
+    m_stopRequested = false;
+    enforceQuota();
+
+    m_running = true;
+    m_thread = thread(&EvidenceCapture::run, this);
+
+    cout << "NG 证据留存: " << folder << "（配额 " << quotaBytes / (1024 * 1024) << " MB，已有 "
+         << m_stored.size() << " 帧 / " << m_diskBytes.load() / (1024 * 1024) << " MB，队列 "
+         << queueCapacity << " 帧）" << endl;
+    return true;
+}
+
+void EvidenceCapture::submit(shared_ptr<EvidenceFrame> frame)
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    shared_ptr<EvidenceFrame> dropped;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (m_queue.size() >= m_capacity)
+        {
+            dropped = move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_queue.push_back(move(frame));
+        m_queueDepth = m_queue.size();
+    }
+    m_condition.notify_one();
+
+    // 被丢弃的帧在锁外释放
+    m_submitted++;
+    if (dropped)
+    {
+        m_dropped++;
+    }
+}
+
+void EvidenceCapture::stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+    m_running = false;
+}
+
+void EvidenceCapture::run()
+{
+    while (true)
+    {
+        shared_ptr<EvidenceFrame> frame;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopRequested || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                break; // 已请求停止且队列已写完
+            }
+            frame = move(m_queue.front());
+            m_queue.pop_front();
+            m_queueDepth = m_queue.size();
+        }
+
+        uint64_t bytes = 0;
+        if (writeFrame(*frame, bytes))
+        {
+            m_written++;
+        }
+        else
+        {
+            m_writeErrors++;
+        }
+        m_diskBytes += bytes;
+        enforceQuota();
+    }
+}
+
+bool EvidenceCapture::writeFrame(const EvidenceFrame &frame, uint64_t &bytes)
+{
+    fs::path directory = fs::path(m_folder) / evidenceDirectoryName(frame);
+    error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec)
+    {
+        cerr << "错误: 无法创建证据目录 " << directory.string() << ": " << ec.message() << endl;
+        return false;
+    }
+
+    vector<int> jpegParams = {IMWRITE_JPEG_QUALITY, EvidenceConfig::JPEG_QUALITY};
+    vector<int> pngParams = {IMWRITE_PNG_COMPRESSION, EvidenceConfig::PNG_COMPRESSION};
+    bool ok = true;
+    try
+    {
+        if (!frame.resized.empty())
+        {
+            ok &= imwrite((directory / "resized.jpg").string(), frame.resized, jpegParams);
+        }
+        if (!frame.mask.empty())
+        {
+            ok &= imwrite((directory / "mask.png").string(), frame.mask, pngParams);
+        }
+        if (!frame.finalResult.empty())
+        {
+            ok &= imwrite((directory / "final.png").string(), frame.finalResult, pngParams);
+        }
+        Mat overlay = renderOverlay(frame);
+        if (!overlay.empty())
+        {
+            ok &= imwrite((directory / "overlay.jpg").string(), overlay, jpegParams);
+        }
+    }
+    catch (const cv::Exception &e)
+    {
+        cerr << "错误: 证据编码失败 " << directory.string() << ": " << e.what() << endl;
+        ok = false;
+    }
+
+    // 判定明细：每个模板的得分、最佳角度和是否通过（early-stop 表示得分是早停位置的下界）
+    ofstream summary(directory / "result.txt", ios::trunc);
+    summary << "frame: " << frame.name << "\n";
+    for (const TemplateMatchResult &match : frame.matchResults)
+    {
+        summary << match.filename << "\tscore=" << fixed << setprecision(4) << match.score
+                << "\tangle=" << setprecision(1) << match.bestAngle
+                << "\t" << (match.passed ? "pass" : "fail")
+                << (match.scoreExact ? "" : "\tearly-stop") << "\n";
+    }
+    summary.close();
+    ok &= !summary.fail();
+
+    bytes = directorySize(directory);
+    m_stored.emplace_back(directory.string(), bytes);
+
+    if (!ok)
+    {
+        cerr << "错误: 写入证据失败: " << directory.string() << endl;
+    }
+    return ok;
+}
+
+void EvidenceCapture::enforceQuota()
+{
+    // 最新的一帧总是保留，即使它本身超过配额
+    while (m_diskBytes.load() > m_quotaBytes && m_stored.size() > 1)
+    {
+        const auto &oldest = m_stored.front();
+        error_code ec;
+        fs::remove_all(oldest.first, ec);
+        if (ec)
+        {
+            cerr << "警告: 无法删除旧证据 " << oldest.first << ": " << ec.message() << endl;
+        }
+        m_diskBytes -= min(oldest.second, m_diskBytes.load());
+        m_evicted++;
+        m_stored.pop_front();
+    }
+}
+
+void EvidenceCapture::printSummary() const
+{
+    cout << "NG 证据: 提交 " << m_submitted.load() << " 帧, 写入 " << m_written.load()
+         << ", 队列满丢弃 " << m_dropped.load() << ", 超配额删除 " << m_evicted.load()
+         << ", 写入失败 " << m_writeErrors.load()
+         << ", 占用 " << fixed << setprecision(1) << m_diskBytes.load() / (1024.0 * 1024.0) << " MB" << endl;
+}
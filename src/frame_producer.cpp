@@ -0,0 +1,199 @@
+/*
+ * 共享内存帧生产者 - 模拟相机进程
+ *
+ * 功能：
+ * 1. 预先解码文件夹中的所有图片（相机进程本来就持有原始BGR帧）
+ * 2. 创建共享内存帧环，按指定帧率循环写入原始帧
+ * 3. 从结果环读取检测进程写回的判定并输出
+ *
+ * 使用方法：
+ * frame_producer.exe <image_folder> [fps] [loops] [ring_name]
+ * 例如：frame_producer.exe image_samples/2 10 3
+ * 然后在另一个终端运行：tableware_detection.exe --shm
+ */
+
+#include "frame_ring.h"
+#include "latency_budget.h"
+#include "config_constants.h"
+#include "image_files.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <iomanip>
+
+using namespace cv;
+using namespace std;
+namespace fs = std::filesystem;
+
+// 读取文件夹中的所有图片（按文件名排序）
+static bool loadFrames(const string &folder, vector<Mat> &frames, vector<string> &names)
+{
+    vector<string> files;
+    if (!listImageFiles(folder, files))
+    {
+        return false;
+    }
+
+    for (const string &file : files)
+    {
+        Mat image = imread(file, IMREAD_COLOR);
+        if (image.empty())
+        {
+            cerr << "警告: 无法加载图片 " << file << "，已跳过" << endl;
+            continue;
+        }
+        frames.push_back(image);
+        names.push_back(fs::path(file).filename().string());
+    }
+
+    if (frames.empty())
+    {
+        cerr << "错误: 文件夹中没有可用的图片: " << folder << endl;
+        return false;
+    }
+
+    cout << "已加载 " << frames.size() << " 帧" << endl;
+    return true;
+}
+
+// 输出所有已返回的判定
+static void drainResults(FrameRingProducer &ring, deque<pair<uint64_t, size_t>> &inFlight,
+                         const vector<string> &names, uint64_t &received, uint64_t &okCount,
+                         uint64_t &degradedCount)
+{
+    FrameVerdict verdict;
+    while (ring.pollResult(verdict))
+    {
+        // 找到对应的源图片（跳过结果环被覆盖的帧）
+        while (!inFlight.empty() && inFlight.front().first < verdict.sequence)
+        {
+            inFlight.pop_front();
+        }
+        string name = "?";
+        if (!inFlight.empty() && inFlight.front().first == verdict.sequence)
+        {
+            name = names[inFlight.front().second];
+            inFlight.pop_front();
+        }
+
+        auto nowNs = chrono::duration_cast<chrono::nanoseconds>(
+                         chrono::steady_clock::now().time_since_epoch())
+                         .count();
+        double latencyMs = (nowNs - int64_t(verdict.timestampNs)) / 1e6;
+
+        cout << "[帧 " << verdict.sequence << "] " << name << ": "
+             << (verdict.isOK ? "OK" : "NG") << fixed << setprecision(1)
+             << " (处理 " << verdict.processingUs / 1000.0 << "ms, 端到端 " << latencyMs << "ms)";
+        for (size_t i = 0; i < verdict.scores.size(); i++)
+        {
+            cout << " no." << (i + 1) << "=" << setprecision(3) << verdict.scores[i];
+        }
+        if (verdict.degraded)
+        {
+            // 降级帧附带各阶段耗时，便于判断预算花在哪里
+            cout << " [降级 " << degradeLevelName(DegradeLevel(verdict.degradeLevel)) << ":";
+            for (const auto &stage : verdict.stageMs)
+            {
+                cout << " " << stage.first << "=" << setprecision(1) << stage.second << "ms";
+            }
+            cout << "]";
+        }
+        cout << endl;
+
+        received++;
+        okCount += verdict.isOK ? 1 : 0;
+        degradedCount += verdict.degraded ? 1 : 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <image_folder> [fps] [loops] [ring_name]" << endl;
+        cout << "Example: " << argv[0] << " image_samples/2 10 3" << endl;
+        return -1;
+    }
+
+    string folder = argv[1];
+    double fps = (argc >= 3) ? atof(argv[2]) : 10.0;
+    int loops = (argc >= 4) ? atoi(argv[3]) : 1; // 0 表示无限循环
+    string ringName = (argc >= 5) ? argv[4] : FrameRingConfig::DEFAULT_RING_NAME;
+
+    vector<Mat> frames;
+    vector<string> names;
+    if (!loadFrames(folder, frames, names))
+    {
+        return -1;
+    }
+
+    int maxWidth = 0;
+    int maxHeight = 0;
+    for (const Mat &frame : frames)
+    {
+        maxWidth = max(maxWidth, frame.cols);
+        maxHeight = max(maxHeight, frame.rows);
+    }
+
+    FrameRingProducer ring;
+    if (!ring.create(ringName, maxWidth, maxHeight))
+    {
+        return -1;
+    }
+
+    cout << "等待检测进程连接: tableware_detection --shm " << ringName << endl;
+    while (!ring.consumerAttached())
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    auto interval = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(fps > 0 ? 1.0 / fps : 0.0));
+    auto nextFrameTime = chrono::steady_clock::now();
+
+    deque<pair<uint64_t, size_t>> inFlight; // (帧序号, 图片索引)
+    uint64_t received = 0;
+    uint64_t okCount = 0;
+    uint64_t degradedCount = 0;
+
+    for (int loop = 0; loops == 0 || loop < loops; loop++)
+    {
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            this_thread::sleep_until(nextFrameTime);
+            nextFrameTime += interval;
+
+            uint64_t sequence = 0;
+            if (ring.tryPush(frames[i], sequence))
+            {
+                inFlight.emplace_back(sequence, i);
+            }
+
+            drainResults(ring, inFlight, names, received, okCount, degradedCount);
+        }
+    }
+
+    // 通知结束并等待剩余判定返回
+    ring.markDone();
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(30);
+    while (received + ring.lostResults() < ring.publishedFrames() &&
+           chrono::steady_clock::now() < deadline)
+    {
+        drainResults(ring, inFlight, names, received, okCount, degradedCount);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    cout << "====================================" << endl;
+    cout << "发布帧数: " << ring.publishedFrames() << ", 丢帧: " << ring.droppedFrames()
+         << ", 收到判定: " << received << " (OK " << okCount << ", NG " << (received - okCount) << ")"
+         << ", 降级: " << degradedCount << ", 丢失判定: " << ring.lostResults() << endl;
+    cout << "====================================" << endl;
+    return 0;
+}
@@ -0,0 +1,361 @@
+/*
+ * 共享内存帧环模块 - 相机进程与检测进程之间的零拷贝帧传递
+ */
+
+#include "frame_ring.h"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <new>
+#include <algorithm>
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+
+static FrameSlotHeader *slotAt(FrameRingHeader *header, uint64_t sequence)
+{
+    uint8_t *base = reinterpret_cast<uint8_t *>(header);
+    uint64_t index = sequence % header->slotCount;
+    return reinterpret_cast<FrameSlotHeader *>(base + header->framesOffset + index * header->slotStride);
+}
+
+static FrameResultSlot *resultAt(FrameRingHeader *header, uint64_t index)
+{
+    uint8_t *base = reinterpret_cast<uint8_t *>(header);
+    FrameResultSlot *results = reinterpret_cast<FrameResultSlot *>(base + header->resultsOffset);
+    return &results[index % header->resultSlotCount];
+}
+
+static uint64_t steadyNowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// ==================== 生产者 ====================
+
+bool FrameRingProducer::create(const string &name, int maxWidth, int maxHeight)
+{
+    if (maxWidth <= 0 || maxHeight <= 0)
+    {
+        cerr << "错误: 帧环尺寸无效: " << maxWidth << "x" << maxHeight << endl;
+        return false;
+    }
+
+    // 计算布局：每个帧槽 = 槽头 + 最大帧数据，按页对齐以便相机直接 DMA/写入
+    uint64_t headerBytes = alignUp(sizeof(FrameRingHeader), 4096);
+    uint64_t frameBytes = uint64_t(maxWidth) * uint64_t(maxHeight) * 3;
+    uint64_t slotStride = alignUp(sizeof(FrameSlotHeader) + frameBytes, 4096);
+    uint64_t framesBytes = slotStride * FrameRingConfig::SLOT_COUNT;
+    uint64_t resultsBytes = sizeof(FrameResultSlot) * FrameRingConfig::RESULT_SLOT_COUNT;
+    uint64_t totalSize = headerBytes + framesBytes + resultsBytes;
+
+    if (!m_region.createShared(name, static_cast<size_t>(totalSize)))
+    {
+        return false;
+    }
+
+    // 在共享内存上构造头部和结果槽（原子变量需要就地构造）
+    // magic 最后写入（见下），消费者在此之前看到的是 0，会继续等待
+    m_header = new (m_region.data()) FrameRingHeader();
+    m_header->version = FRAME_RING_VERSION;
+    m_header->slotCount = FrameRingConfig::SLOT_COUNT;
+    m_header->resultSlotCount = FrameRingConfig::RESULT_SLOT_COUNT;
+    m_header->maxWidth = maxWidth;
+    m_header->maxHeight = maxHeight;
+    m_header->slotStride = slotStride;
+    m_header->framesOffset = headerBytes;
+    m_header->resultsOffset = headerBytes + framesBytes;
+    m_header->totalSize = totalSize;
+
+    uint8_t *base = static_cast<uint8_t *>(m_region.data());
+    for (int i = 0; i < FrameRingConfig::RESULT_SLOT_COUNT; i++)
+    {
+        new (base + m_header->resultsOffset + i * sizeof(FrameResultSlot)) FrameResultSlot();
+    }
+    m_header->producerHeartbeatNs.store(steadyNowNs(), memory_order_relaxed);
+
+    // 发布：release 保证消费者看到 magic 时头部和结果槽都已初始化
+    atomic_thread_fence(memory_order_release);
+    reinterpret_cast<volatile uint32_t &>(m_header->magic) = FRAME_RING_MAGIC;
+
+    m_nextResult = 0;
+    m_lostResults = 0;
+
+    cout << "已创建共享内存帧环 " << name << ": " << FrameRingConfig::SLOT_COUNT << " 个帧槽 x "
+         << maxWidth << "x" << maxHeight << ", 共 " << (totalSize >> 20) << "MB" << endl;
+    return true;
+}
+
+bool FrameRingProducer::consumerAttached() const
+{
+    // 生产者等待消费者时也算活动，避免消费者刚连接就因心跳过旧而退出
+    if (m_header != nullptr)
+    {
+        m_header->producerHeartbeatNs.store(steadyNowNs(), memory_order_relaxed);
+    }
+    return m_header != nullptr && m_header->consumerAttached.load(memory_order_acquire) != 0;
+}
+
+bool FrameRingProducer::tryPush(const Mat &bgrFrame, uint64_t &sequence)
+{
+    if (m_header == nullptr || bgrFrame.empty() || bgrFrame.type() != CV_8UC3 ||
+        bgrFrame.cols > int(m_header->maxWidth) || bgrFrame.rows > int(m_header->maxHeight))
+    {
+        cerr << "错误: 帧格式与帧环不符" << endl;
+        return false;
+    }
+
+    uint64_t writeSeq = m_header->writeSeq.load(memory_order_relaxed);
+    uint64_t readSeq = m_header->readSeq.load(memory_order_acquire);
+
+    // 环满：消费者仍持有全部槽，丢弃这一帧（相机不能等待）
+    if (writeSeq - readSeq >= m_header->slotCount)
+    {
+        m_header->droppedFrames.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    FrameSlotHeader *slot = slotAt(m_header, writeSeq);
+    slot->sequence = writeSeq;
+    slot->timestampNs = steadyNowNs();
+    slot->width = bgrFrame.cols;
+    slot->height = bgrFrame.rows;
+    slot->step = bgrFrame.cols * 3;
+
+    Mat slotFrame(bgrFrame.rows, bgrFrame.cols, CV_8UC3, reinterpret_cast<uint8_t *>(slot) + sizeof(FrameSlotHeader), slot->step);
+    bgrFrame.copyTo(slotFrame);
+
+    // 发布：release 保证消费者看到 writeSeq 时帧数据已写完
+    m_header->writeSeq.store(writeSeq + 1, memory_order_release);
+    m_header->producerHeartbeatNs.store(slot->timestampNs, memory_order_relaxed);
+    sequence = writeSeq;
+    return true;
+}
+
+bool FrameRingProducer::pollResult(FrameVerdict &verdict)
+{
+    if (m_header == nullptr)
+    {
+        return false;
+    }
+
+    m_header->producerHeartbeatNs.store(steadyNowNs(), memory_order_relaxed);
+
+    uint64_t available = m_header->resultSeq.load(memory_order_acquire);
+    if (m_nextResult >= available)
+    {
+        return false;
+    }
+
+    // 读取太慢导致结果环被覆盖，跳到仍然有效的最早结果
+    if (available - m_nextResult > m_header->resultSlotCount)
+    {
+        uint64_t skipTo = available - m_header->resultSlotCount;
+        m_lostResults += skipTo - m_nextResult;
+        m_nextResult = skipTo;
+    }
+
+    // 标记必须是本次要读的结果序号：0 表示正在写入，其他值表示槽位已被下一圈覆盖
+    FrameResultSlot *slot = resultAt(m_header, m_nextResult);
+    uint64_t expectedTag = m_nextResult + 1;
+    if (slot->tag.load(memory_order_acquire) != expectedTag)
+    {
+        return false; // 下次重试（被覆盖时由上面的跳过逻辑追上）
+    }
+
+    verdict.sequence = slot->sequence;
+    verdict.timestampNs = slot->timestampNs;
+    verdict.processingUs = slot->processingUs;
+    verdict.isOK = slot->isOK != 0;
+    uint32_t count = min<uint32_t>(slot->templateCount, FrameRingConfig::MAX_RESULT_TEMPLATES);
+    verdict.scores.assign(slot->scores, slot->scores + count);
+    verdict.angles.assign(slot->angles, slot->angles + count);
+    verdict.degraded = slot->degraded != 0;
+    verdict.degradeLevel = slot->degradeLevel;
+    uint32_t stageCount = min<uint32_t>(slot->stageCount, FrameRingConfig::MAX_RESULT_STAGES);
+    verdict.stageMs.clear();
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        const char *name = slot->stageNames[i];
+        verdict.stageMs.emplace_back(string(name, strnlen(name, FrameRingConfig::RESULT_STAGE_NAME_LENGTH)),
+                                     slot->stageMs[i]);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (slot->tag.load(memory_order_relaxed) != expectedTag)
+    {
+        return false; // 读取期间被覆盖，下次重试
+    }
+
+    m_nextResult++;
+    return true;
+}
+
+void FrameRingProducer::markDone()
+{
+    if (m_header != nullptr)
+    {
+        m_header->producerDone.store(1, memory_order_release);
+    }
+}
+
+uint64_t FrameRingProducer::publishedFrames() const
+{
+    return m_header != nullptr ? m_header->writeSeq.load(memory_order_relaxed) : 0;
+}
+
+uint64_t FrameRingProducer::droppedFrames() const
+{
+    return m_header != nullptr ? m_header->droppedFrames.load(memory_order_relaxed) : 0;
+}
+
+// ==================== 消费者 ====================
+
+bool FrameRingConsumer::attach(const string &name, int timeoutMs)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+
+    // 等待生产者创建共享内存并写完头部（magic 最后写入；尚未设置大小或 magic 时重新打开再等）
+    FrameRingHeader *header = nullptr;
+    while (true)
+    {
+        if (m_region.openShared(name) && m_region.size() >= sizeof(FrameRingHeader))
+        {
+            header = static_cast<FrameRingHeader *>(m_region.data());
+            uint32_t magic = reinterpret_cast<volatile const uint32_t &>(header->magic);
+            atomic_thread_fence(memory_order_acquire);
+            if (magic == FRAME_RING_MAGIC)
+            {
+                break;
+            }
+        }
+        m_region.release();
+
+        if (chrono::steady_clock::now() >= deadline)
+        {
+            cerr << "错误: 等待共享内存帧环超时: " << name << endl;
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    if (header->version != FRAME_RING_VERSION || header->totalSize > m_region.size())
+    {
+        cerr << "错误: 共享内存帧环格式不匹配: " << name << " (版本 " << header->version
+             << ", 期望 " << FRAME_RING_VERSION << ")" << endl;
+        m_region.release();
+        return false;
+    }
+
+    m_header = header;
+    m_current = m_header->readSeq.load(memory_order_acquire);
+    m_holding = false;
+    m_header->consumerAttached.store(1, memory_order_release);
+
+    cout << "已连接共享内存帧环 " << name << ": " << m_header->slotCount << " 个帧槽, 最大帧 "
+         << m_header->maxWidth << "x" << m_header->maxHeight << endl;
+    return true;
+}
+
+bool FrameRingConsumer::acquire(Mat &frame, uint64_t &sequence, uint64_t &timestampNs)
+{
+    if (m_header == nullptr || m_holding)
+    {
+        return false;
+    }
+
+    if (m_current >= m_header->writeSeq.load(memory_order_acquire))
+    {
+        return false;
+    }
+
+    FrameSlotHeader *slot = slotAt(m_header, m_current);
+
+    // 直接在共享内存上构造 Mat 头，不拷贝像素
+    frame = Mat(slot->height, slot->width, CV_8UC3, reinterpret_cast<uint8_t *>(slot) + sizeof(FrameSlotHeader), slot->step);
+    sequence = slot->sequence;
+    timestampNs = slot->timestampNs;
+    m_holding = true;
+    return true;
+}
+
+void FrameRingConsumer::release()
+{
+    if (m_header == nullptr || !m_holding)
+    {
+        return;
+    }
+
+    m_current++;
+    m_holding = false;
+    m_header->readSeq.store(m_current, memory_order_release);
+}
+
+void FrameRingConsumer::publishResult(const FrameVerdict &verdict)
+{
+    if (m_header == nullptr)
+    {
+        return;
+    }
+
+    uint64_t index = m_header->resultSeq.load(memory_order_relaxed);
+    FrameResultSlot *slot = resultAt(m_header, index);
+
+    // seqlock 写入：先清标记，写完数据后再设置标记
+    slot->tag.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->sequence = verdict.sequence;
+    slot->timestampNs = verdict.timestampNs;
+    slot->processingUs = verdict.processingUs;
+    slot->isOK = verdict.isOK ? 1 : 0;
+    uint32_t count = min<uint32_t>(uint32_t(verdict.scores.size()), FrameRingConfig::MAX_RESULT_TEMPLATES);
+    slot->templateCount = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        slot->scores[i] = verdict.scores[i];
+        slot->angles[i] = i < verdict.angles.size() ? verdict.angles[i] : 0.0f;
+    }
+    slot->degraded = verdict.degraded ? 1 : 0;
+    slot->degradeLevel = verdict.degradeLevel;
+    uint32_t stageCount = min<uint32_t>(uint32_t(verdict.stageMs.size()), FrameRingConfig::MAX_RESULT_STAGES);
+    slot->stageCount = stageCount;
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        const string &name = verdict.stageMs[i].first;
+        size_t length = min<size_t>(name.size(), FrameRingConfig::RESULT_STAGE_NAME_LENGTH - 1);
+        memcpy(slot->stageNames[i], name.data(), length);
+        slot->stageNames[i][length] = '\0';
+        slot->stageMs[i] = verdict.stageMs[i].second;
+    }
+
+    slot->tag.store(index + 1, memory_order_release);
+    m_header->resultSeq.store(index + 1, memory_order_release);
+}
+
+bool FrameRingConsumer::finished() const
+{
+    if (m_header == nullptr)
+    {
+        return true;
+    }
+
+    // 先读结束标记再读 writeSeq，保证结束前发布的帧都已可见
+    bool done = m_header->producerDone.load(memory_order_acquire) != 0;
+    return done && m_current >= m_header->writeSeq.load(memory_order_acquire);
+}
+
+bool FrameRingConsumer::producerLost(int timeoutMs) const
+{
+    if (m_header == nullptr)
+    {
+        return true;
+    }
+
+    uint64_t heartbeat = m_header->producerHeartbeatNs.load(memory_order_relaxed);
+    uint64_t now = steadyNowNs();
+    return now > heartbeat && now - heartbeat > uint64_t(timeoutMs) * 1000000ULL;
+}
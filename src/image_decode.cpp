@@ -0,0 +1,225 @@
+/*
+ * 检测用图像解码 - 读取JPEG文件头中的EXIF方向和原始分辨率，忽略方向解码
+ */
+
+#include "image_decode.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+static const uint16_t EXIF_ORIENTATION_TAG = 0x0112;
+
+// 解析 APP1 段中的 EXIF 方向标签（IFD0）
+static int parseExifOrientation(const vector<uint8_t> &segment)
+{
+    static const char EXIF_HEADER[6] = {'E', 'x', 'i', 'f', 0, 0};
+    if (segment.size() < sizeof(EXIF_HEADER) + 8 || memcmp(segment.data(), EXIF_HEADER, sizeof(EXIF_HEADER)) != 0)
+    {
+        return 1;
+    }
+
+    // TIFF 头：字节序 + 42 + IFD0 偏移
+    const uint8_t *tiff = segment.data() + sizeof(EXIF_HEADER);
+    size_t size = segment.size() - sizeof(EXIF_HEADER);
+    bool littleEndian = (tiff[0] == 'I' && tiff[1] == 'I');
+    bool bigEndian = (tiff[0] == 'M' && tiff[1] == 'M');
+    if (!littleEndian && !bigEndian)
+    {
+        return 1;
+    }
+
+    auto read16 = [&](size_t offset) -> uint32_t
+    {
+        return littleEndian ? uint32_t(tiff[offset] | (tiff[offset + 1] << 8))
+                            : uint32_t((tiff[offset] << 8) | tiff[offset + 1]);
+    };
+    auto read32 = [&](size_t offset) -> uint32_t
+    {
+        return littleEndian ? (read16(offset) | (read16(offset + 2) << 16))
+                            : ((read16(offset) << 16) | read16(offset + 2));
+    };
+
+    if (read16(2) != 42)
+    {
+        return 1;
+    }
+
+    size_t ifd = read32(4);
+    if (ifd + 2 > size)
+    {
+        return 1;
+    }
+
+    uint32_t entryCount = read16(ifd);
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        size_t entry = ifd + 2 + size_t(i) * 12;
+        if (entry + 12 > size)
+        {
+            break;
+        }
+        if (read16(entry) == EXIF_ORIENTATION_TAG)
+        {
+            uint32_t orientation = read16(entry + 8);
+            return (orientation >= 1 && orientation <= 8) ? int(orientation) : 1;
+        }
+    }
+    return 1;
+}
+
+int readJpegOrientation(const string &path, Size &imageSize)
+{
+    imageSize = Size();
+
+    ifstream in(path, ios::binary);
+    uint8_t soi[2] = {0, 0};
+    if (!in.read(reinterpret_cast<char *>(soi), 2) || soi[0] != 0xFF || soi[1] != 0xD8)
+    {
+        return 1; // 不是 JPEG
+    }
+
+    int orientation = 1;
+
+    // 逐段读取文件头，直到 SOF（原始分辨率）或 SOS（图像数据开始）
+    while (in)
+    {
+        uint8_t marker[2];
+        if (!in.read(reinterpret_cast<char *>(marker), 2) || marker[0] != 0xFF)
+        {
+            break;
+        }
+        while (marker[1] == 0xFF && in.read(reinterpret_cast<char *>(&marker[1]), 1))
+        {
+            // 跳过填充字节
+        }
+
+        uint8_t type = marker[1];
+        if (type == 0x01 || (type >= 0xD0 && type <= 0xD8))
+        {
+            continue; // 无长度的独立标记
+        }
+        if (type == 0xDA || type == 0xD9)
+        {
+            break;
+        }
+
+        uint8_t lengthBytes[2];
+        if (!in.read(reinterpret_cast<char *>(lengthBytes), 2))
+        {
+            break;
+        }
+        int length = (lengthBytes[0] << 8) | lengthBytes[1];
+        if (length < 2)
+        {
+            break;
+        }
+
+        bool isStartOfFrame = (type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC);
+        if (type == 0xE1)
+        {
+            vector<uint8_t> segment(length - 2);
+            if (!in.read(reinterpret_cast<char *>(segment.data()), segment.size()))
+            {
+                break;
+            }
+            if (orientation == 1)
+            {
+                orientation = parseExifOrientation(segment);
+            }
+        }
+        else if (isStartOfFrame && length >= 7)
+        {
+            uint8_t frame[5]; // 精度、高度、宽度
+            if (!in.read(reinterpret_cast<char *>(frame), 5))
+            {
+                break;
+            }
+            imageSize = Size((frame[3] << 8) | frame[4], (frame[1] << 8) | frame[2]);
+            break; // EXIF 段总在 SOF 之前
+        }
+        else
+        {
+            in.seekg(length - 2, ios::cur);
+        }
+    }
+
+    return orientation;
+}
+
+void applyExifOrientation(const Mat &src, Mat &dst, int orientation)
+{
+    switch (orientation)
+    {
+    case 2: // 水平翻转
+        flip(src, dst, 1);
+        break;
+    case 3: // 旋转180°
+        flip(src, dst, -1);
+        break;
+    case 4: // 垂直翻转
+        flip(src, dst, 0);
+        break;
+    case 5: // 转置
+        transpose(src, dst);
+        break;
+    case 6: // 顺时针90°
+        transpose(src, dst);
+        flip(dst, dst, 1);
+        break;
+    case 7: // 反转置
+        transpose(src, dst);
+        flip(dst, dst, -1);
+        break;
+    case 8: // 逆时针90°
+        transpose(src, dst);
+        flip(dst, dst, 0);
+        break;
+    default:
+        dst = src;
+        break;
+    }
+}
+
+Mat decodeImageForDetection(const string &path, int reduction, DecodedImageInfo &info)
+{
+    info = DecodedImageInfo();
+
+    Size jpegSize;
+    info.exifOrientation = readJpegOrientation(path, jpegSize);
+
+    // 非 JPEG（或文件头无法解析）按原方式解码
+    if (jpegSize.empty())
+    {
+        return imread(path, IMREAD_COLOR);
+    }
+
+    int flags = IMREAD_COLOR;
+    switch (reduction)
+    {
+    case 1:
+        break;
+    case 2:
+        flags = IMREAD_REDUCED_COLOR_2;
+        break;
+    case 4:
+        flags = IMREAD_REDUCED_COLOR_4;
+        break;
+    case 8:
+        flags = IMREAD_REDUCED_COLOR_8;
+        break;
+    default:
+        cerr << "警告: 不支持的解码缩小倍数 " << reduction << "，使用全分辨率解码" << endl;
+        reduction = 1;
+        break;
+    }
+
+    Mat image = imread(path, flags | IMREAD_IGNORE_ORIENTATION);
+    info.sourceSize = jpegSize;
+    info.reduction = reduction;
+    return image;
+}
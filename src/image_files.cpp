@@ -0,0 +1,47 @@
+/*
+ * 图片文件夹遍历 - 各工具共用的图片文件列表
+ */
+
+#include "image_files.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+bool listImageFiles(const string &folder, vector<string> &files, bool fullPaths)
+{
+    files.clear();
+    try
+    {
+        if (!fs::exists(folder) || !fs::is_directory(folder))
+        {
+            cerr << "错误: 图片文件夹不存在或不是目录: " << folder << endl;
+            return false;
+        }
+
+        for (const auto &entry : fs::directory_iterator(folder))
+        {
+            if (!entry.is_regular_file())
+            {
+                continue;
+            }
+
+            string extension = entry.path().extension().string();
+            transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" ||
+                extension == ".bmp" || extension == ".tiff" || extension == ".tif")
+            {
+                files.push_back(fullPaths ? entry.path().string() : entry.path().filename().string());
+            }
+        }
+        sort(files.begin(), files.end());
+    }
+    catch (const fs::filesystem_error &e)
+    {
+        cerr << "错误: 读取图片文件夹失败: " << e.what() << endl;
+        return false;
+    }
+    return true;
+}
@@ -4,16 +4,42 @@
 
 #include "image_processing.h"
 #include "config_constants.h"
+#include "memory_accounting.h"
+#include "bounded_match.h"
 #include <iostream>
 #include <iomanip>
 #include <cmath>
 #include <filesystem>
 #include <algorithm>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <chrono>
 
 using namespace cv;
 using namespace std;
 namespace fs = std::filesystem;
 
+// ==================== 逐帧输出 ====================
+
+static thread_local ostream *t_frameLog = nullptr;
+
+ostream &frameLog()
+{
+    return t_frameLog ? *t_frameLog : cout;
+}
+
+FrameLogCapture::FrameLogCapture(ostringstream &buffer)
+    : m_previous(t_frameLog)
+{
+    t_frameLog = &buffer;
+}
+
+FrameLogCapture::~FrameLogCapture()
+{
+    t_frameLog = m_previous;
+}
+
 // 图像缩放函数 - 按指定比例缩放图像
 Mat resizeImageByScale(const Mat &originalImage, double scale)
 {
@@ -34,7 +60,7 @@ Mat resizeImageByScale(const Mat &originalImage, double scale)
     Mat resizedImage;
     resize(originalImage, resizedImage, Size(newWidth, newHeight), 0, 0, INTER_LINEAR);
 
-    cout << "Image resized from " << originalImage.cols << "x" << originalImage.rows
+    frameLog() << "Image resized from " << originalImage.cols << "x" << originalImage.rows
          << " to " << resizedImage.cols << "x" << resizedImage.rows
          << " (scale: " << scale << ")" << endl;
 
@@ -53,7 +79,7 @@ Mat applyBlurProcessing(const Mat &inputImage)
     // 如果禁用模糊处理，直接返回原图
     if (!Config::ENABLE_BLUR)
     {
-        cout << "Blur processing disabled" << endl;
+        frameLog() << "Blur processing disabled" << endl;
         return inputImage.clone();
     }
 
@@ -66,7 +92,7 @@ Mat applyBlurProcessing(const Mat &inputImage)
     // 可选：添加中值滤波进一步去除椒盐噪声
     // medianBlur(blurredImage, blurredImage, 3);
 
-    cout << "Applied Gaussian blur processing (kernel: " << Config::BLUR_KERNEL_SIZE
+    frameLog() << "Applied Gaussian blur processing (kernel: " << Config::BLUR_KERNEL_SIZE
          << "x" << Config::BLUR_KERNEL_SIZE << ", sigma: " << Config::BLUR_SIGMA << ")" << endl;
 
     return blurredImage;
@@ -74,6 +100,12 @@ Mat applyBlurProcessing(const Mat &inputImage)
 
 // 方案A：预编译优化的多HSV二值分割函数 (直接接受BGR图像)
 Mat createHueBinaryMask(const Mat &bgrImage)
+{
+    return createHueBinaryMask(bgrImage, defaultHsvRanges());
+}
+
+// 多HSV二值分割（使用给定的颜色范围，如配方中的范围）
+Mat createHueBinaryMask(const Mat &bgrImage, const vector<HsvRange> &ranges)
 {
     if (bgrImage.empty())
     {
@@ -87,13 +119,12 @@ Mat createHueBinaryMask(const Mat &bgrImage)
 
     Mat result = Mat::zeros(hsvImage.size(), CV_8UC1);
 
-    // 编译器会完全展开这个循环，实现最佳性能
-    for (int i = 0; i < Config::RANGE_COUNT; ++i)
+    for (const HsvRange &range : ranges)
     {
         Mat mask;
         inRange(hsvImage,
-                Scalar(Config::HSV_RANGES[i][0], Config::HSV_RANGES[i][2], Config::HSV_RANGES[i][4]),
-                Scalar(Config::HSV_RANGES[i][1], Config::HSV_RANGES[i][3], Config::HSV_RANGES[i][5]),
+                Scalar(range.hueMin, range.satMin, range.valMin),
+                Scalar(range.hueMax, range.satMax, range.valMax),
                 mask);
         result |= mask;
     }
@@ -162,10 +193,10 @@ Mat createLABBinaryMask(const Mat &bgrImage)
     int woodPixels = countNonZero(woodMask);
     int totalPixels = countNonZero(finalMask);
 
-    cout << "LAB Detection Results:" << endl;
-    cout << "- White pixels detected: " << whitePixels << endl;
-    cout << "- Wood pixels detected: " << woodPixels << endl;
-    cout << "- Total LAB pixels: " << totalPixels << endl;
+    frameLog() << "LAB Detection Results:" << endl;
+    frameLog() << "- White pixels detected: " << whitePixels << endl;
+    frameLog() << "- Wood pixels detected: " << woodPixels << endl;
+    frameLog() << "- Total LAB pixels: " << totalPixels << endl;
 
     return finalMask;
 }
@@ -243,7 +274,15 @@ Mat fillConnectedComponents(const Mat &binaryImage)
 // 基于全图面积百分比的连通域过滤函数
 Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercentage)
 {
-    Mat result = binaryImage.clone();
+    vector<BlobOrientation> components;
+    return filterConnectedComponentsByPercent(binaryImage, minPercentage, components);
+}
+
+// 基于全图面积百分比的连通域过滤函数（同时输出保留下来的连通域统计）
+Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercentage,
+                                       vector<BlobOrientation> &components)
+{
+    components.clear();
     Mat labels, stats, centroids;
 
     // 连通域分析
@@ -253,6 +292,9 @@ Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercent
     int totalArea = binaryImage.rows * binaryImage.cols;
     int minArea = totalArea * (minPercentage / 100.0);
 
+    // 每个标签对应的输出值：保留=255，删除=0（背景标签0保持为0）
+    vector<uchar> labelValue(numComponents, 0);
+
     // 遍历每个连通域
     for (int i = 1; i < numComponents; i++) // 跳过背景 (标签0)
     {
@@ -261,15 +303,26 @@ Mat filterConnectedComponentsByPercent(const Mat &binaryImage, double minPercent
         // 只保留面积大于阈值的连通域
         if (area >= minArea)
         {
-            // 填充该连通域
-            Mat mask = (labels == i);
-            result.setTo(255, mask);
+            labelValue[i] = 255;
+
+            // 记录外接矩形和主轴方向，供模板匹配限定候选窗口和预测角度
+            Rect bbox(stats.at<int>(i, CC_STAT_LEFT), stats.at<int>(i, CC_STAT_TOP),
+                      stats.at<int>(i, CC_STAT_WIDTH), stats.at<int>(i, CC_STAT_HEIGHT));
+            BlobOrientation component = orientationFromMoments(moments(labels(bbox) == i, true));
+            component.bbox = bbox;
+            components.push_back(component);
         }
-        else
+    }
+
+    // 按标签查表一次生成结果，避免每个连通域都做一次全图比较
+    Mat result(binaryImage.size(), CV_8UC1);
+    for (int y = 0; y < labels.rows; y++)
+    {
+        const int *labelRow = labels.ptr<int>(y);
+        uchar *resultRow = result.ptr<uchar>(y);
+        for (int x = 0; x < labels.cols; x++)
         {
-            // 删除小的连通域
-            Mat mask = (labels == i);
-            result.setTo(0, mask);
+            resultRow[x] = labelValue[labelRow[x]];
         }
     }
 
@@ -313,44 +366,12 @@ Mat enhanceContrast_CLAHE(const Mat &inputImage)
         clahe->apply(inputImage, result);
     }
 
-    cout << "Applied CLAHE enhancement (clip: 3.0, tiles: 8x8)" << endl;
+    frameLog() << "Applied CLAHE enhancement (clip: 3.0, tiles: 8x8)" << endl;
     return result;
 }
 
 // ==================== 模板匹配判断实现 ====================
 
-/**
- * @brief 旋转图像（保持图像完整，不裁剪）
- * @param src 源图像
- * @param angle 旋转角度（度，正值为逆时针）
- * @return 旋转后的图像
- */
-static Mat rotateImage(const Mat &src, double angle)
-{
-    // 计算旋转中心
-    Point2f center(src.cols / 2.0, src.rows / 2.0);
-
-    // 获取旋转矩阵
-    Mat rotMat = getRotationMatrix2D(center, angle, 1.0);
-
-    // 计算旋转后的边界框尺寸
-    double abs_cos = abs(rotMat.at<double>(0, 0));
-    double abs_sin = abs(rotMat.at<double>(0, 1));
-    int new_w = int(src.rows * abs_sin + src.cols * abs_cos);
-    int new_h = int(src.rows * abs_cos + src.cols * abs_sin);
-
-    // 调整旋转矩阵以适应新尺寸
-    rotMat.at<double>(0, 2) += (new_w / 2.0 - center.x);
-    rotMat.at<double>(1, 2) += (new_h / 2.0 - center.y);
-
-    // 执行旋转
-    Mat rotated;
-    warpAffine(src, rotated, rotMat, Size(new_w, new_h),
-               INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
-
-    return rotated;
-}
-
 bool judgeByTemplateMatch(
     const Mat &resultImage,
     const string &templateFolder,
@@ -365,76 +386,250 @@ bool judgeByTemplateMatch(
         return false;
     }
 
-    // Step 1: 获取模板文件列表（读取文件夹中所有图片文件）
-    vector<string> files;
+    // 现场扫描模板文件夹构建模板库（常驻进程应使用 prepareTemplateBank 只构建一次）
+    TemplateBank bank;
+    if (!buildTemplateBank(templateFolder, thresholds, bank))
+    {
+        return false;
+    }
+
+    return judgeByTemplateBank(resultImage, bank, results);
+}
+
+/**
+ * @brief 根据连通域方向选择要测试的模板变体
+ *
+ * 对每个足够细长、且主轴长度与模板相近的连通域，由主轴角度差预测旋转角度，
+ * 取最接近的预旋转角度及其相邻一个步长；按与预测角度的距离排序。
+ * 模板或连通域过圆（方向不稳定）、没有可用的连通域时返回全部变体（全角度扫描）。
+ */
+static vector<size_t> selectVariantsByOrientation(const TemplateEntry &entry,
+                                                  const vector<BlobOrientation> &blobs,
+                                                  double rotationMax, double rotationStep,
+                                                  bool &estimated)
+{
+    estimated = false;
+
+    vector<size_t> allVariants(entry.variants.size());
+    for (size_t i = 0; i < allVariants.size(); i++)
+    {
+        allVariants[i] = i;
+    }
+
+    if (!TemplateMatchConfig::ENABLE_ORIENTATION_ESTIMATE ||
+        entry.orientation.elongation < TemplateMatchConfig::MIN_ORIENTATION_ELONGATION)
+    {
+        return allVariants;
+    }
 
-    try
+    vector<pair<double, size_t>> ranked; // (与预测角度的距离, 变体下标)
+    for (const BlobOrientation &blob : blobs)
     {
-        // 检查文件夹是否存在
-        if (!fs::exists(templateFolder) || !fs::is_directory(templateFolder))
+        if (blob.elongation < TemplateMatchConfig::MIN_ORIENTATION_ELONGATION)
+        {
+            continue;
+        }
+
+        double lengthRatio = blob.majorLength / max(entry.orientation.majorLength, 1e-9);
+        if (lengthRatio > TemplateMatchConfig::ORIENTATION_LENGTH_RATIO ||
+            lengthRatio < 1.0 / TemplateMatchConfig::ORIENTATION_LENGTH_RATIO)
+        {
+            continue;
+        }
+
+        double predicted = predictRotationAngle(blob.axisAngle, entry.orientation.axisAngle);
+        if (abs(predicted) > rotationMax + rotationStep)
         {
-            cerr << "错误: 模板文件夹不存在或不是目录: " << templateFolder << endl;
-            return false;
+            continue; // 超出角度范围，不是这个模板的倾斜实例
         }
 
-        // 遍历文件夹中的所有文件
-        for (const auto &entry : fs::directory_iterator(templateFolder))
+        // 最接近预测值的预旋转角度
+        size_t nearest = 0;
+        for (size_t i = 1; i < entry.variants.size(); i++)
         {
-            if (entry.is_regular_file())
+            if (abs(entry.variants[i].angle - predicted) < abs(entry.variants[nearest].angle - predicted))
             {
-                string filename = entry.path().filename().string();
-                string extension = entry.path().extension().string();
+                nearest = i;
+            }
+        }
 
-                // 只处理图片文件（.jpg, .jpeg, .png, .bmp）
-                transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-                if (extension == ".jpg" || extension == ".jpeg" ||
-                    extension == ".png" || extension == ".bmp")
+        // 加上相邻一个步长的角度作为细化
+        for (size_t i = 0; i < entry.variants.size(); i++)
+        {
+            if (abs(entry.variants[i].angle - entry.variants[nearest].angle) <= rotationStep + 1e-6)
+            {
+                ranked.emplace_back(abs(entry.variants[i].angle - predicted), i);
+            }
+        }
+    }
+
+    if (ranked.empty())
+    {
+        return allVariants;
+    }
+
+    stable_sort(ranked.begin(), ranked.end(),
+                [](const pair<double, size_t> &a, const pair<double, size_t> &b)
+                { return a.first < b.first; });
+
+    vector<size_t> selected;
+    for (const auto &candidate : ranked)
+    {
+        if (find(selected.begin(), selected.end(), candidate.second) == selected.end())
+        {
+            selected.push_back(candidate.second);
+        }
+    }
+
+    estimated = true;
+    return selected;
+}
+
+/**
+ * @brief 计算连通域周围的候选匹配窗口
+ *
+ * 最终结果图中所有非零像素都属于某个连通域。与任何连通域都不重叠的模板位置下方全为0，
+ * TM_SQDIFF_NORMED 在这些位置恒为 1（相似度0），因此只需计算与连通域外接矩形重叠的位置：
+ * 每个外接矩形向外扩展 (模板尺寸-1)，重叠的窗口合并后分别匹配取最小值。
+ * @return 候选窗口；没有连通域时为空（最小归一化平方差为 1.0）
+ */
+static vector<Rect> buildCandidateWindows(const Mat &resultImage, const Mat &templ,
+                                          const vector<BlobOrientation> &components)
+{
+    Rect imageRect(0, 0, resultImage.cols, resultImage.rows);
+
+    vector<Rect> windows;
+    for (const BlobOrientation &component : components)
+    {
+        const Rect &box = component.bbox;
+        Rect window(box.x - templ.cols + 1, box.y - templ.rows + 1,
+                    box.width + 2 * templ.cols - 2, box.height + 2 * templ.rows - 2);
+        window &= imageRect;
+        if (window.width >= templ.cols && window.height >= templ.rows)
+        {
+            windows.push_back(window);
+        }
+    }
+
+    // 合并相互重叠的窗口，避免重复计算
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < windows.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < windows.size(); j++)
+            {
+                if ((windows[i] & windows[j]).area() > 0)
                 {
-                    files.push_back(filename);
+                    windows[i] |= windows[j];
+                    windows.erase(windows.begin() + j);
+                    merged = true;
+                    break;
                 }
             }
         }
+    }
+
+    return windows;
+}
 
-        // 按文件名排序
-        sort(files.begin(), files.end());
+/**
+ * @brief 在给定窗口内执行模板匹配，返回最小归一化平方差
+ * @param boundedMatcher 非空时使用有界匹配（见 bounded_match.h），否则逐窗口 matchTemplate
+ * @param passValue 有界匹配的通过界限（1-阈值），找到后立即停止；为负数时求精确最小值
+ */
+static double matchInWindows(const Mat &resultImage, const Mat &templ, const vector<Rect> &windows,
+                             const BoundedSqdiffMatcher *boundedMatcher, double passValue,
+                             BoundedMatchStats &stats)
+{
+    double bestMinVal = 1.0;
+    for (const Rect &window : windows)
+    {
+        if (boundedMatcher)
+        {
+            if (boundedMatcher->match(templ, window, passValue, bestMinVal, stats))
+            {
+                break;
+            }
+            continue;
+        }
+
+        Mat matchResult;
+        matchTemplate(resultImage(window), templ, matchResult, TM_SQDIFF_NORMED);
+
+        double minVal;
+        minMaxLoc(matchResult, &minVal, nullptr, nullptr, nullptr);
+        bestMinVal = min(bestMinVal, minVal);
     }
-    catch (const fs::filesystem_error &e)
+
+    return bestMinVal;
+}
+
+bool judgeByTemplateBank(
+    const Mat &resultImage,
+    const TemplateBank &bank,
+    vector<TemplateMatchResult> &results)
+{
+    // 没有现成的连通域统计时，在结果图上重新分析
+    vector<BlobOrientation> components;
+    if (!resultImage.empty())
     {
-        cerr << "错误: 读取模板文件夹失败: " << e.what() << endl;
-        return false;
+        components = estimateBlobOrientations(resultImage);
     }
 
-    if (files.empty())
+    return judgeByTemplateBank(resultImage, components, bank, results);
+}
+
+bool judgeByTemplateBank(
+    const Mat &resultImage,
+    const vector<BlobOrientation> &components,
+    const TemplateBank &bank,
+    vector<TemplateMatchResult> &results,
+    bool testAllAngles,
+    FrameBudget *budget)
+{
+    results.clear();
+
+    if (resultImage.empty())
     {
-        cerr << "错误: 模板文件夹中没有找到图片文件" << endl;
+        cerr << "错误: 输入图像为空" << endl;
         return false;
     }
 
-    // Step 2: 验证配置
-    if (files.size() != thresholds.size())
+    if (bank.templates.empty())
     {
-        cerr << "错误: 模板数量(" << files.size()
-             << ") != 阈值数量(" << thresholds.size() << ")" << endl;
+        cerr << "错误: 模板库为空" << endl;
         return false;
     }
 
-    cout << "找到 " << files.size() << " 个模板文件" << endl;
-
-    // Step 3: 遍历每个模板进行多角度匹配
+    // 遍历每个模板进行多角度匹配
     bool allPassed = true;
+    int resultTotalPixels = resultImage.cols * resultImage.rows;
 
-    for (size_t i = 0; i < files.size(); i++)
+    // 诊断统计（结果图白色像素和密度）不影响判定，预算紧张时第一个被省掉
+    bool diagnostics = !(budget && budget->atLeast(DegradeLevel::SkipDiagnostics));
+    int resultWhitePixels = diagnostics ? countNonZero(resultImage) : 0;
+
+    // 有界匹配：积分图在所有模板、角度之间共用
+    unique_ptr<BoundedSqdiffMatcher> boundedMatcher;
+    if (TemplateMatchConfig::ENABLE_BOUNDED_MATCH && resultImage.type() == CV_8UC1)
     {
-        string templatePath = templateFolder + "/" + files[i];
-        Mat templateImg = imread(templatePath, IMREAD_GRAYSCALE);
+        boundedMatcher = make_unique<BoundedSqdiffMatcher>(resultImage);
+    }
 
+    for (const TemplateEntry &entry : bank.templates)
+    {
+        auto templateStart = chrono::steady_clock::now();
         TemplateMatchResult result;
-        result.filename = files[i];
+        result.filename = entry.filename;
+        result.angleScores.assign(entry.variants.size(), numeric_limits<float>::quiet_NaN());
 
-        if (templateImg.empty())
+        if (entry.variants.empty())
         {
-            cerr << "错误: 无法加载模板 " << files[i] << endl;
+            cerr << "错误: 无法加载模板 " << entry.filename << endl;
             result.score = 0.0;
+            result.bestAngle = 0.0;
             result.passed = false;
             allPassed = false;
             results.push_back(result);
@@ -442,84 +637,124 @@ bool judgeByTemplateMatch(
         }
 
         // 初始检查模板尺寸（原始角度）
-        int templateTotalPixels = templateImg.cols * templateImg.rows;
-        int templateWhitePixels = countNonZero(templateImg);
-        int resultTotalPixels = resultImage.cols * resultImage.rows;
-        int resultWhitePixels = countNonZero(resultImage);
-
-        double templateDensity = (double)templateWhitePixels / templateTotalPixels * 100.0;
-        double resultDensity = (double)resultWhitePixels / resultTotalPixels * 100.0;
-
-        cout << "模板 " << files[i] << " 原始尺寸: "
-             << templateImg.cols << "x" << templateImg.rows
-             << " (" << templateTotalPixels << "像素)"
-             << ", 白色像素: " << templateWhitePixels
-             << " (密度: " << fixed << setprecision(1) << templateDensity << "%)" << endl;
-        cout << "结果图尺寸: " << resultImage.cols << "x" << resultImage.rows
-             << " (" << resultTotalPixels << "像素)"
-             << ", 白色像素: " << resultWhitePixels
-             << " (密度: " << resultDensity << "%)" << endl;
-
-        if (templateImg.cols > resultImage.cols ||
-            templateImg.rows > resultImage.rows)
+        const TemplateVariant &original = entry.variants[0];
+        int templateTotalPixels = original.image.cols * original.image.rows;
+        int templateWhitePixels = original.whitePixels;
+
+        if (diagnostics)
+        {
+            double templateDensity = (double)templateWhitePixels / templateTotalPixels * 100.0;
+            double resultDensity = (double)resultWhitePixels / resultTotalPixels * 100.0;
+
+            frameLog() << "模板 " << entry.filename << " 原始尺寸: "
+                 << original.image.cols << "x" << original.image.rows
+                 << " (" << templateTotalPixels << "像素)"
+                 << ", 白色像素: " << templateWhitePixels
+                 << " (密度: " << fixed << setprecision(1) << templateDensity << "%)" << endl;
+            frameLog() << "结果图尺寸: " << resultImage.cols << "x" << resultImage.rows
+                 << " (" << resultTotalPixels << "像素)"
+                 << ", 白色像素: " << resultWhitePixels
+                 << " (密度: " << resultDensity << "%)" << endl;
+        }
+
+        if (original.image.cols > resultImage.cols ||
+            original.image.rows > resultImage.rows)
         {
-            cerr << "警告: 模板 " << files[i] << " 尺寸("
-                 << templateImg.cols << "x" << templateImg.rows
+            cerr << "警告: 模板 " << entry.filename << " 尺寸("
+                 << original.image.cols << "x" << original.image.rows
                  << ") 大于结果图(" << resultImage.cols << "x" << resultImage.rows << ")" << endl;
         }
 
-        // Step 4: 多角度旋转匹配
+        // 选择测试角度：能从连通域方向稳定预测时只测预测角度±1步，否则按中心扩散顺序全角度扫描
+        bool estimated = false;
+        vector<size_t> variantOrder = selectVariantsByOrientation(entry, components, bank.rotationMax,
+                                                                  bank.rotationStep, estimated);
+        if (estimated)
+        {
+            frameLog() << "  方向估计: 测试角度";
+            for (size_t index : variantOrder)
+            {
+                frameLog() << " " << entry.variants[index].angle << "°";
+            }
+            frameLog() << endl;
+        }
+        else if (TemplateMatchConfig::ENABLE_ORIENTATION_ESTIMATE)
+        {
+            frameLog() << "  方向估计不稳定，回退到全角度扫描" << endl;
+        }
+
+        // 预算降级：只测试顺序最靠前的角度（方向预测最接近的角度或 0°）
+        if (budget && budget->atLeast(DegradeLevel::FewerAngles) &&
+            variantOrder.size() > size_t(LatencyBudgetConfig::REDUCED_ANGLE_COUNT))
+        {
+            variantOrder.resize(LatencyBudgetConfig::REDUCED_ANGLE_COUNT);
+            frameLog() << "  预算降级: 只测试 " << variantOrder.size() << " 个角度" << endl;
+        }
+
+        // 多角度旋转匹配（模板已预旋转）
         double bestSimilarity = 0.0;
         double bestAngle = 0.0;
         int testedAngles = 0;
 
-        // 构建角度测试序列：0, +step, -step, +2*step, -2*step, ...
-        vector<double> angleSequence;
-        angleSequence.push_back(0.0); // 先测试0度
-        for (double offset = TemplateMatchConfig::ROTATION_STEP;
-             offset <= TemplateMatchConfig::ROTATION_MAX;
-             offset += TemplateMatchConfig::ROTATION_STEP)
-        {
-            angleSequence.push_back(offset);  // 正角度
-            angleSequence.push_back(-offset); // 负角度
-        }
+        // 有界匹配的通过界限：记录全部角度得分时求精确最小值，否则找到 minVal <= 1-阈值 即停止
+        double passValue = testAllAngles ? -1.0 : 1.0 - entry.threshold;
+        BoundedMatchStats boundedStats;
+        double lastAngleMs = 0.0;
 
-        // 按照中心扩散顺序测试角度
-        for (double angle : angleSequence)
+        for (size_t index : variantOrder)
         {
-            // 旋转模板
-            Mat rotatedTemplate = (abs(angle) < 0.01) ? templateImg.clone() : rotateImage(templateImg, angle);
+            // 剩余预算不够再测一个角度时停止（每个模板至少测试一个角度）
+            if (budget && budget->enabled() && testedAngles > 0 && budget->remainingMs() < lastAngleMs)
+            {
+                budget->markAnglesCut();
+                frameLog() << "  预算不足，停止测试剩余角度" << endl;
+                break;
+            }
+            auto angleStart = chrono::steady_clock::now();
+
+            const TemplateVariant &variant = entry.variants[index];
+            const Mat &rotatedTemplate = variant.image;
+            double angle = variant.angle;
 
             // 检查旋转后的模板尺寸
             if (rotatedTemplate.cols > resultImage.cols ||
                 rotatedTemplate.rows > resultImage.rows)
             {
                 // 旋转后尺寸过大，跳过此角度
-                cout << "  角度" << angle << "°: 旋转后尺寸过大("
+                frameLog() << "  角度" << angle << "°: 旋转后尺寸过大("
                      << rotatedTemplate.cols << "x" << rotatedTemplate.rows
                      << " > " << resultImage.cols << "x" << resultImage.rows
                      << ")，跳过此角度" << endl;
                 continue;
             }
 
-            // 执行模板匹配（使用归一化平方差）
-            Mat matchResult;
-            matchTemplate(resultImage, rotatedTemplate, matchResult, TM_SQDIFF_NORMED);
-
-            // 找到最小差值
-            double minVal;
-            minMaxLoc(matchResult, &minVal, nullptr, nullptr, nullptr);
+            // 执行模板匹配（使用归一化平方差），默认只在连通域周围的候选窗口内匹配
+            vector<Rect> windows;
+            if (TemplateMatchConfig::ENABLE_CANDIDATE_WINDOWS)
+            {
+                windows = buildCandidateWindows(resultImage, rotatedTemplate, components);
+            }
+            else
+            {
+                windows.push_back(Rect(0, 0, resultImage.cols, resultImage.rows));
+            }
+            double minVal = matchInWindows(resultImage, rotatedTemplate, windows, boundedMatcher.get(),
+                                           passValue, boundedStats);
 
             // 转换为相似度（越大越好）
             double similarity = 1.0 - minVal;
 
             // 调试输出
-            int templateWhitePixels = countNonZero(rotatedTemplate);
-            int resultWhitePixels = countNonZero(resultImage);
-            cout << "  角度" << angle << "°: minVal=" << fixed << setprecision(3) << minVal
+            frameLog() << "  角度" << angle << "°: minVal=" << fixed << setprecision(3) << minVal
                  << ", similarity=" << similarity
-                 << ", 模板白色像素=" << templateWhitePixels
-                 << ", 结果图白色像素=" << resultWhitePixels << endl;
+                 << ", 模板白色像素=" << variant.whitePixels;
+            if (diagnostics)
+            {
+                frameLog() << ", 结果图白色像素=" << resultWhitePixels;
+            }
+            frameLog() << endl;
+
+            result.angleScores[index] = float(similarity);
 
             // 更新最佳得分
             if (similarity > bestSimilarity)
@@ -529,39 +764,183 @@ bool judgeByTemplateMatch(
             }
 
             testedAngles++;
+            lastAngleMs = chrono::duration<double, milli>(chrono::steady_clock::now() - angleStart).count();
 
-            // 早停：如果找到足够好的匹配，提前退出
-            if (similarity >= thresholds[i])
+            // 早停：如果找到足够好的匹配，提前退出（记录全部角度得分时不早停）
+            if (similarity >= entry.threshold && !testAllAngles)
             {
-                // cout << "  找到满足阈值的匹配，提前退出" << endl;
                 break;
             }
         }
 
+        if (boundedMatcher && diagnostics)
+        {
+            frameLog() << "  有界匹配: 检查位置 " << boundedStats.positions
+                 << ", 空白 " << boundedStats.empty
+                 << ", 下界排除 " << boundedStats.pruned
+                 << ", 部分和放弃 " << boundedStats.abandoned
+                 << ", 完整计算 " << boundedStats.evaluated << endl;
+        }
+
         // 判断是否通过
         result.score = bestSimilarity;
         result.bestAngle = bestAngle;
-        result.passed = (bestSimilarity >= thresholds[i]);
+        result.passed = (bestSimilarity >= entry.threshold);
+        result.scoreExact = !(boundedMatcher && result.passed && !testAllAngles);
 
         if (!result.passed)
         {
             allPassed = false;
         }
 
+        result.matchMs = chrono::duration<double, milli>(chrono::steady_clock::now() - templateStart).count();
         results.push_back(result);
 
         // 打印结果
-        cout << "模板 " << files[i] << ": "
-             << "最佳相似度=" << fixed << setprecision(3) << bestSimilarity
+        frameLog() << "模板 " << entry.filename << ": "
+             << (result.scoreExact ? "最佳相似度=" : "相似度(早停)=") << fixed << setprecision(3) << bestSimilarity
              << " (角度=" << bestAngle << "°, 测试角度数=" << testedAngles
-             << ", 阈值=" << thresholds[i] << ") "
+             << ", 阈值=" << entry.threshold << ") "
              << (result.passed ? "[通过]" : "[失败]") << endl;
 
         // 添加空行分隔不同模板的输出
-        cout << endl;
+        frameLog() << endl;
     }
 
     return allPassed;
 }
 
-// ==================== 模板匹配判断实现 ====================
+// ==================== 完整检测流水线 ====================
+
+// 流水线中约定的输出名（显示面板和模板匹配使用）
+static const string OUTPUT_RESIZED = "resized";
+static const string OUTPUT_MASK = "mask";
+static const string OUTPUT_MORPH = "morph";
+static const string OUTPUT_FILLED = "filled";
+static const string OUTPUT_FINAL = "final";
+
+bool buildDetectionGraph(bool keepIntermediates, StageGraph &graph)
+{
+    vector<string> lines = PipelineConfig::DEFAULT_GRAPH;
+
+    // 配置文件存在时覆盖默认节点图
+    ifstream file(PipelineConfig::GRAPH_FILE);
+    if (file.is_open())
+    {
+        lines.clear();
+        string line;
+        while (getline(file, line))
+        {
+            lines.push_back(line);
+        }
+        cout << "使用流水线配置文件: " << PipelineConfig::GRAPH_FILE << endl;
+    }
+
+    if (!graph.load(lines))
+    {
+        return false;
+    }
+
+    if (!graph.hasOutput(OUTPUT_FINAL))
+    {
+        cerr << "错误: 流水线缺少模板匹配使用的输出 \"" << OUTPUT_FINAL << "\"" << endl;
+        return false;
+    }
+
+    vector<string> required = {OUTPUT_FINAL};
+    if (keepIntermediates)
+    {
+        required.insert(required.end(), {OUTPUT_RESIZED, OUTPUT_MASK, OUTPUT_MORPH, OUTPUT_FILLED});
+    }
+
+    if (!graph.compile(required))
+    {
+        return false;
+    }
+
+    cout << "流水线: " << graph.describe() << endl;
+    return true;
+}
+
+bool runDetectionPipeline(const Mat &bgrImage, const Recipe &recipe, StageGraph &graph,
+                          DetectionPipelineResult &output, bool testAllAngles,
+                          const DecodedImageInfo &decodeInfo, FrameBudget *budget)
+{
+    bool coarse = budget && budget->atLeast(DegradeLevel::CoarseResize);
+
+    // 1. 按节点图执行预处理（缩放 → 二值化 → 形态学 → 轮廓填充 → 连通域过滤，以配置为准）
+    StageContext context;
+    context.exifOrientation = decodeInfo.exifOrientation;
+    context.sourceSize = decodeInfo.sourceSize;
+    context.recipe = &recipe;
+    if (coarse)
+    {
+        context.resizeScale = Config::RESIZE_SCALE * LatencyBudgetConfig::COARSE_SCALE_FACTOR;
+    }
+    map<string, Mat> outputs;
+    if (!graph.execute(bgrImage, context, outputs))
+    {
+        output.isOK = false;
+        return false;
+    }
+
+    output.resizedImage = outputs[OUTPUT_RESIZED];
+    output.originalBinary = outputs[OUTPUT_MASK];
+    output.morphProcessed = outputs[OUTPUT_MORPH];
+    output.contourFilled = outputs[OUTPUT_FILLED];
+    output.finalResult = outputs[OUTPUT_FINAL];
+    output.components = move(context.components);
+    output.stageMs = move(context.stageMs);
+
+    // 连通域统计只描述 cc_filter 的输出；final 不是由 cc_filter 产生（自定义节点图）时按 final 重新计算，
+    // 否则模板匹配会按别的图上的连通域选择角度和候选窗口
+    if (!coarse && !output.finalResult.empty() &&
+        (context.componentsImage.data != output.finalResult.data ||
+         context.componentsImage.size() != output.finalResult.size()))
+    {
+        output.components = estimateBlobOrientations(output.finalResult);
+    }
+
+    // 粗缩放分割的结果放大回正常尺寸（模板按 RESIZE_SCALE 制作），连通域统计在放大后的图上重新计算
+    if (coarse)
+    {
+        Size source = decodeInfo.sourceSize.empty() ? bgrImage.size() : decodeInfo.sourceSize;
+        Size target(max(1, static_cast<int>(source.width * Config::RESIZE_SCALE)),
+                    max(1, static_cast<int>(source.height * Config::RESIZE_SCALE)));
+        if (decodeInfo.exifOrientation >= 5)
+        {
+            swap(target.width, target.height); // 转置类方向
+        }
+
+        auto upscaleStart = chrono::steady_clock::now();
+        Mat upscaled;
+        resize(output.finalResult, upscaled, target, 0, 0, INTER_NEAREST);
+        output.finalResult = upscaled;
+        output.components = estimateBlobOrientations(output.finalResult);
+        output.stageMs.emplace_back("coarse_upscale",
+                                    chrono::duration<double, milli>(chrono::steady_clock::now() - upscaleStart).count());
+    }
+
+    // 2. 模板匹配判断 NG/OK
+    frameLog() << "\n========== 模板匹配判断 ==========" << endl;
+
+    auto matchStart = chrono::steady_clock::now();
+    {
+        MemoryStageScope stage(MemoryStage::Matching);
+        output.isOK = judgeByTemplateBank(output.finalResult, output.components, recipe.bank, output.matchResults,
+                                          testAllAngles, budget);
+    }
+    output.stageMs.emplace_back("matching", chrono::duration<double, milli>(chrono::steady_clock::now() - matchStart).count());
+
+    if (budget)
+    {
+        for (const auto &stageTime : output.stageMs)
+        {
+            budget->recordStage(stageTime.first, stageTime.second);
+        }
+        output.degraded = budget->degraded();
+        output.degradeLevel = budget->level();
+    }
+
+    return output.isOK;
+}
@@ -0,0 +1,164 @@
+/*
+ * 单帧延迟预算 - 降级级别选择、耗时预测与统计
+ */
+
+#include "latency_budget.h"
+#include "config_constants.h"
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+static_assert(sizeof(LatencyBudgetConfig::LEVEL_COST_RATIO) / sizeof(LatencyBudgetConfig::LEVEL_COST_RATIO[0]) ==
+                  size_t(DegradeLevel::Count),
+              "LEVEL_COST_RATIO 必须为每个降级级别给出一个值");
+
+const char *degradeLevelName(DegradeLevel level)
+{
+    switch (level)
+    {
+    case DegradeLevel::None:
+        return "none";
+    case DegradeLevel::SkipDiagnostics:
+        return "skip_diagnostics";
+    case DegradeLevel::FewerAngles:
+        return "fewer_angles";
+    case DegradeLevel::CoarseResize:
+        return "coarse_resize";
+    default:
+        return "unknown";
+    }
+}
+
+// ==================== FrameBudget ====================
+
+FrameBudget::FrameBudget(chrono::steady_clock::time_point frameStart, double budgetMs, DegradeLevel level)
+    : m_frameStart(frameStart),
+      m_processingStart(chrono::steady_clock::now()),
+      m_budgetMs(budgetMs),
+      m_level(level)
+{
+}
+
+double FrameBudget::elapsedMs() const
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - m_frameStart).count();
+}
+
+double FrameBudget::remainingMs() const
+{
+    return m_budgetMs - elapsedMs();
+}
+
+double FrameBudget::processingMs() const
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - m_processingStart).count();
+}
+
+// ==================== LatencyBudgetController ====================
+
+LatencyBudgetController::LatencyBudgetController(double budgetMs)
+    : m_budgetMs(budgetMs)
+{
+}
+
+bool LatencyBudgetController::isFresh(int level) const
+{
+    return m_measured[level] && m_frames - m_lastSampleFrame[level] <= LatencyBudgetConfig::PREDICTION_STALE_FRAMES;
+}
+
+double LatencyBudgetController::predictedMs(int level) const
+{
+    if (isFresh(level))
+    {
+        return m_predictedMs[level];
+    }
+
+    // 该级别还没有样本或样本已过期：由最近的有新样本的级别按经验比例估算
+    for (int distance = 1; distance < LEVEL_COUNT; distance++)
+    {
+        for (int other : {level - distance, level + distance})
+        {
+            if (other >= 0 && other < LEVEL_COUNT && isFresh(other))
+            {
+                return m_predictedMs[other] * LatencyBudgetConfig::LEVEL_COST_RATIO[level] /
+                       LatencyBudgetConfig::LEVEL_COST_RATIO[other];
+            }
+        }
+    }
+    return m_measured[level] ? m_predictedMs[level] : 0.0; // 第一帧：没有任何依据，不降级
+}
+
+FrameBudget LatencyBudgetController::beginFrame(chrono::steady_clock::time_point frameStart)
+{
+    if (!enabled())
+    {
+        return FrameBudget();
+    }
+
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count();
+    double available = (m_budgetMs - elapsed) * LatencyBudgetConfig::SAFETY_MARGIN;
+
+    // 选择预测耗时能放进剩余预算的最低级别；都放不下时使用最高级别
+    int level = LEVEL_COUNT - 1;
+    for (int candidate = 0; candidate < LEVEL_COUNT; candidate++)
+    {
+        if (predictedMs(candidate) <= available)
+        {
+            level = candidate;
+            break;
+        }
+    }
+
+    return FrameBudget(frameStart, m_budgetMs, DegradeLevel(level));
+}
+
+void LatencyBudgetController::endFrame(const FrameBudget &budget)
+{
+    if (!budget.enabled())
+    {
+        return;
+    }
+
+    int level = int(budget.level());
+    double cost = budget.processingMs();
+
+    // 少测了角度的帧耗时只是下限：低于当前预测时不用于更新
+    // 过期的预测不再参与平滑，直接以新样本重新开始
+    if (!budget.anglesCut() || !isFresh(level) || cost > m_predictedMs[level])
+    {
+        m_predictedMs[level] = isFresh(level)
+                                   ? m_predictedMs[level] + LatencyBudgetConfig::EWMA_ALPHA * (cost - m_predictedMs[level])
+                                   : cost;
+        m_measured[level] = true;
+        m_lastSampleFrame[level] = m_frames;
+    }
+
+    m_frames++;
+    m_levelFrames[level]++;
+    m_anglesCutFrames += budget.anglesCut() ? 1 : 0;
+    m_overruns += (budget.elapsedMs() > m_budgetMs) ? 1 : 0;
+}
+
+void LatencyBudgetController::printSummary() const
+{
+    if (!enabled())
+    {
+        return;
+    }
+
+    cout << "========== 延迟预算 (" << fixed << setprecision(1) << m_budgetMs << " ms/帧) ==========" << endl;
+    for (int level = 0; level < LEVEL_COUNT; level++)
+    {
+        cout << left << setw(20) << degradeLevelName(DegradeLevel(level)) << right
+             << setw(8) << m_levelFrames[level] << " 帧";
+        if (m_measured[level])
+        {
+            cout << "  (预测处理耗时 " << setprecision(2) << m_predictedMs[level] << " ms)";
+        }
+        cout << endl;
+    }
+    cout << "匹配中途少测角度: " << m_anglesCutFrames << " 帧, 超出预算: " << m_overruns
+         << " / " << m_frames << " 帧" << endl;
+    cout << "====================================" << endl;
+}
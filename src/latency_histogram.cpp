@@ -0,0 +1,192 @@
+/*
+ * 延迟直方图 - 对数-线性分桶、百分位查询与 .hgrm 输出
+ */
+
+#include "latency_histogram.h"
+#include "config_constants.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+// 最高有效位位置（value > 0）
+static int highestBit(uint64_t value)
+{
+    int bit = 0;
+    for (int step = 32; step > 0; step >>= 1)
+    {
+        if (value >> (bit + step))
+        {
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+LatencyHistogram::LatencyHistogram(uint64_t maxValue, int subBucketBits)
+    : m_maxTrackable(max<uint64_t>(maxValue, 1)),
+      m_subBucketBits(min(max(subBucketBits, 1), 30))
+{
+    m_counts.assign(bucketIndex(m_maxTrackable) + 1, 0);
+}
+
+LatencyHistogram::LatencyHistogram()
+    : LatencyHistogram(LatencyHistogramConfig::MAX_VALUE_US, LatencyHistogramConfig::SUB_BUCKET_BITS)
+{
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) const
+{
+    value = min(value, m_maxTrackable);
+    uint64_t subCount = uint64_t(1) << m_subBucketBits;
+    if (value < subCount)
+    {
+        return size_t(value);
+    }
+
+    // 2^msb 区间按最高 S 位分桶：top 落在 [2^(S-1), 2^S)
+    uint64_t half = subCount >> 1;
+    int shift = highestBit(value) - (m_subBucketBits - 1);
+    uint64_t top = value >> shift;
+    return size_t(subCount + uint64_t(shift - 1) * half + (top - half));
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) const
+{
+    uint64_t subCount = uint64_t(1) << m_subBucketBits;
+    if (index < subCount)
+    {
+        return index;
+    }
+
+    uint64_t half = subCount >> 1;
+    uint64_t offset = index - subCount;
+    int shift = int(offset / half) + 1;
+    uint64_t top = offset % half + half;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+    value = min(value, m_maxTrackable);
+    m_counts[bucketIndex(value)]++;
+    m_count++;
+    m_min = min(m_min, value);
+    m_max = max(m_max, value);
+    m_sum += value;
+    m_sumSquares += (long double)value * value;
+}
+
+void LatencyHistogram::reset()
+{
+    fill(m_counts.begin(), m_counts.end(), 0);
+    m_count = 0;
+    m_min = UINT64_MAX;
+    m_max = 0;
+    m_sum = 0.0L;
+    m_sumSquares = 0.0L;
+}
+
+bool LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    if (other.m_maxTrackable != m_maxTrackable || other.m_subBucketBits != m_subBucketBits)
+    {
+        cerr << "错误: 直方图范围或精度不同，无法合并" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < m_counts.size(); i++)
+    {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_min = min(m_min, other.m_min);
+    m_max = max(m_max, other.m_max);
+    m_sum += other.m_sum;
+    m_sumSquares += other.m_sumSquares;
+    return true;
+}
+
+double LatencyHistogram::mean() const
+{
+    return m_count > 0 ? double(m_sum / m_count) : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    if (percent <= 0.0)
+    {
+        return m_min;
+    }
+
+    uint64_t target = uint64_t(ceil(min(percent, 100.0) / 100.0 * m_count));
+    target = max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); i++)
+    {
+        seen += m_counts[i];
+        if (seen >= target)
+        {
+            return min(bucketUpperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+bool LatencyHistogram::writePercentileDistribution(const string &path, double unitScale) const
+{
+    ofstream file(path, ios::trunc);
+    if (!file.is_open())
+    {
+        cerr << "错误: 无法写入直方图文件 " << path << endl;
+        return false;
+    }
+
+    file << fixed;
+    file << setw(12) << "Value" << " " << setw(14) << "Percentile" << " " << setw(10) << "TotalCount"
+         << " " << setw(14) << "1/(1-Percentile)" << "\n\n";
+
+    // 百分位刻度与 HdrHistogram 相同：每接近 100% 一半的距离，刻度加密一倍（每半程5个刻度）
+    double percent = 0.0;
+    while (m_count > 0 && percent < 100.0)
+    {
+        double remaining = 1.0 - percent / 100.0;
+        if (1.0 / remaining > double(m_count))
+        {
+            break; // 超出样本数能分辨的精度
+        }
+
+        uint64_t value = percentile(percent);
+        uint64_t totalCount = max<uint64_t>(uint64_t(ceil(percent / 100.0 * m_count)), 1);
+        file << setprecision(3) << setw(12) << value / unitScale << " " << setprecision(12) << setw(14)
+             << percent / 100.0 << " " << setw(10) << totalCount << " " << setprecision(2) << setw(14)
+             << 1.0 / remaining << "\n";
+
+        int halvings = int(floor(log2(1.0 / remaining)));
+        double ticks = 5.0 * pow(2.0, halvings + 1);
+        percent += 100.0 / ticks;
+    }
+    if (m_count > 0)
+    {
+        file << setprecision(3) << setw(12) << m_max / unitScale << " " << setprecision(12) << setw(14) << 1.0
+             << " " << setw(10) << m_count << "\n";
+    }
+
+    double average = mean();
+    double variance = m_count > 0 ? double(m_sumSquares / m_count) - average * average : 0.0;
+    file << setprecision(3)
+         << "#[Mean    = " << setw(12) << average / unitScale
+         << ", StdDeviation   = " << setw(12) << sqrt(max(variance, 0.0)) / unitScale << "]\n"
+         << "#[Max     = " << setw(12) << m_max / unitScale << ", Total count    = " << setw(12) << m_count << "]\n"
+         << "#[Buckets = " << setw(12) << m_counts.size()
+         << ", SubBuckets     = " << setw(12) << (uint64_t(1) << m_subBucketBits) << "]\n";
+    return true;
+}
@@ -0,0 +1,502 @@
+/*
+ * 合成负载生成器 - 长时间压测检测进程的吞吐量与延迟
+ *
+ * 功能：
+ * 1. 由样本图片生成源源不断的新帧：±ROTATION_MAX 随机旋转、随机平移、亮度/色调抖动、
+ *    随机质量 JPEG 重新编码（压缩伪影）
+ * 2. 通过共享内存帧环按目标帧率发送给检测进程（tableware_detection --shm）
+ *    - fixed：固定间隔的开环发送（不等待判定，检测跟不上时帧环满即丢帧）
+ *    - poisson：指数分布间隔的开环发送（平均帧率为目标帧率，模拟不均匀到达）
+ *    - 帧率为 0 时闭环发送：未返回判定的帧少于帧槽数就立即发送下一帧，测量最大吞吐
+ * 3. 记录延迟直方图和丢帧数，按区间输出统计并覆盖写入 .hgrm 文件，可以运行数小时
+ *
+ * 延迟从计划发送时刻算起（不是实际写入帧环的时刻），发送落后于计划时，
+ * 落后的时间也计入延迟，避免"协调遗漏"让延迟看起来偏低。
+ *
+ * 使用方法：
+ * load_generator.exe <image_folder> [--rate fps] [--arrival fixed|poisson] [--duration seconds]
+ *                    [--pool N] [--generators N] [--seed N] [--histogram file] [--ring ring_name]
+ * 例如：load_generator.exe image_samples/2 --rate 20 --duration 7200
+ * 然后在另一个终端运行：tableware_detection.exe --shm
+ * duration 为 0（默认）时一直运行到 Ctrl+C。
+ */
+
+#include "frame_ring.h"
+#include "latency_histogram.h"
+#include "config_constants.h"
+#include "image_files.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <csignal>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <iomanip>
+
+using namespace cv;
+using namespace std;
+
+static atomic<bool> g_stopRequested{false};
+
+static void handleStopSignal(int)
+{
+    g_stopRequested = true;
+}
+
+static int64_t steadyNs(chrono::steady_clock::time_point time)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// 读取文件夹中的所有样本图片（按文件名排序）
+static bool loadSamples(const string &folder, vector<Mat> &samples)
+{
+    vector<string> files;
+    if (!listImageFiles(folder, files))
+    {
+        return false;
+    }
+
+    for (const string &file : files)
+    {
+        Mat image = imread(file, IMREAD_COLOR);
+        if (image.empty())
+        {
+            cerr << "警告: 无法加载图片 " << file << "，已跳过" << endl;
+            continue;
+        }
+        samples.push_back(image);
+    }
+
+    if (samples.empty())
+    {
+        cerr << "错误: 文件夹中没有可用的图片: " << folder << endl;
+        return false;
+    }
+
+    cout << "已加载 " << samples.size() << " 张样本" << endl;
+    return true;
+}
+
+// 由样本生成一帧：旋转+平移、色调/亮度抖动、JPEG 重新编码
+static Mat synthesizeFrame(const Mat &sample, mt19937 &rng)
+{
+    uniform_real_distribution<double> angleDist(-TemplateMatchConfig::ROTATION_MAX, TemplateMatchConfig::ROTATION_MAX);
+    uniform_real_distribution<double> shiftDist(-LoadGeneratorConfig::MAX_SHIFT_FRACTION,
+                                                LoadGeneratorConfig::MAX_SHIFT_FRACTION);
+    uniform_int_distribution<int> hueDist(-LoadGeneratorConfig::HUE_JITTER, LoadGeneratorConfig::HUE_JITTER);
+    uniform_real_distribution<double> gainDist(1.0 - LoadGeneratorConfig::BRIGHTNESS_JITTER,
+                                               1.0 + LoadGeneratorConfig::BRIGHTNESS_JITTER);
+    uniform_int_distribution<int> qualityDist(LoadGeneratorConfig::JPEG_QUALITY_MIN,
+                                              LoadGeneratorConfig::JPEG_QUALITY_MAX);
+
+    // 旋转+平移：边界用镜像填充，避免黑边落入黑色勺子的 HSV 范围被当成物体
+    Point2f center(sample.cols / 2.0f, sample.rows / 2.0f);
+    Mat transform = getRotationMatrix2D(center, angleDist(rng), 1.0);
+    transform.at<double>(0, 2) += shiftDist(rng) * sample.cols;
+    transform.at<double>(1, 2) += shiftDist(rng) * sample.rows;
+    Mat warped;
+    warpAffine(sample, warped, transform, sample.size(), INTER_LINEAR, BORDER_REFLECT_101);
+
+    // 色调循环偏移（H 通道范围 0-179）、亮度按比例缩放
+    int hueShift = hueDist(rng);
+    Mat hueTable(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++)
+    {
+        hueTable.at<uchar>(0, i) = (i < 180) ? uchar((i + hueShift + 180) % 180) : uchar(i);
+    }
+
+    Mat hsv;
+    cvtColor(warped, hsv, COLOR_BGR2HSV);
+    vector<Mat> channels;
+    split(hsv, channels);
+    LUT(channels[0], hueTable, channels[0]);
+    channels[2].convertTo(channels[2], -1, gainDist(rng), 0.0);
+    merge(channels, hsv);
+    Mat jittered;
+    cvtColor(hsv, jittered, COLOR_HSV2BGR);
+
+    // 重新编码：相机/采集链路的压缩伪影
+    vector<uchar> encoded;
+    imencode(".jpg", jittered, encoded, {IMWRITE_JPEG_QUALITY, qualityDist(rng)});
+    return imdecode(encoded, IMREAD_COLOR);
+}
+
+// 变换帧池：发送线程循环取用，后台线程持续用新生成的帧替换，使帧内容不断变化而生成耗时不影响发送节奏
+class SyntheticFramePool
+{
+public:
+    SyntheticFramePool(const vector<Mat> &samples, unsigned seed) : m_samples(samples), m_seed(seed) {}
+    ~SyntheticFramePool() { stop(); }
+
+    bool fill(int size)
+    {
+        mt19937 rng(m_seed);
+        uniform_int_distribution<size_t> sampleDist(0, m_samples.size() - 1);
+        for (int i = 0; i < size; i++)
+        {
+            Mat frame = synthesizeFrame(m_samples[sampleDist(rng)], rng);
+            if (frame.empty())
+            {
+                cerr << "错误: 生成合成帧失败" << endl;
+                return false;
+            }
+            m_frames.push_back(frame);
+        }
+        m_generated = m_frames.size();
+        return true;
+    }
+
+    void start(int threads)
+    {
+        for (int i = 0; i < threads; i++)
+        {
+            m_threads.emplace_back(&SyntheticFramePool::generatorLoop, this, m_seed + 1 + unsigned(i));
+        }
+    }
+
+    void stop()
+    {
+        m_stop = true;
+        for (thread &generator : m_threads)
+        {
+            generator.join();
+        }
+        m_threads.clear();
+    }
+
+    // 取第 index 帧（共享引用；被替换的旧帧在最后一个引用释放后回收）
+    Mat frame(size_t index)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        return m_frames[index % m_frames.size()];
+    }
+
+    size_t size() const { return m_frames.size(); }
+    uint64_t generated() const { return m_generated; }
+
+private:
+    void generatorLoop(unsigned seed)
+    {
+        mt19937 rng(seed);
+        uniform_int_distribution<size_t> sampleDist(0, m_samples.size() - 1);
+        while (!m_stop)
+        {
+            Mat frame = synthesizeFrame(m_samples[sampleDist(rng)], rng);
+            if (frame.empty())
+            {
+                continue;
+            }
+            size_t slot = m_nextReplace++ % m_frames.size();
+            lock_guard<mutex> lock(m_mutex);
+            m_frames[slot] = frame;
+            m_generated++;
+        }
+    }
+
+    const vector<Mat> &m_samples;
+    unsigned m_seed;
+    vector<Mat> m_frames;
+    mutex m_mutex;
+    vector<thread> m_threads;
+    atomic<bool> m_stop{false};
+    atomic<size_t> m_nextReplace{0};
+    atomic<uint64_t> m_generated{0};
+};
+
+// 压测统计：总体与当前区间各一个直方图
+struct LoadStats
+{
+    LatencyHistogram latency;        // 从计划发送时刻到收到判定（微秒）
+    LatencyHistogram serviceLatency; // 从写入帧环到收到判定（微秒）
+    LatencyHistogram intervalLatency;
+    uint64_t scheduled = 0; // 计划发送的帧数
+    uint64_t received = 0;  // 收到的判定数
+    uint64_t okCount = 0;
+    uint64_t degradedCount = 0;
+    uint64_t intervalReceived = 0;
+};
+
+// 读取所有已返回的判定，记录延迟
+static void drainResults(FrameRingProducer &ring, deque<pair<uint64_t, int64_t>> &inFlight, LoadStats &stats)
+{
+    FrameVerdict verdict;
+    while (ring.pollResult(verdict))
+    {
+        int64_t nowNs = steadyNs(chrono::steady_clock::now());
+
+        // 找到对应帧的计划发送时刻（跳过结果环被覆盖的帧）
+        while (!inFlight.empty() && inFlight.front().first < verdict.sequence)
+        {
+            inFlight.pop_front();
+        }
+        int64_t scheduledNs = int64_t(verdict.timestampNs);
+        if (!inFlight.empty() && inFlight.front().first == verdict.sequence)
+        {
+            scheduledNs = inFlight.front().second;
+            inFlight.pop_front();
+        }
+
+        uint64_t latencyUs = uint64_t(max<int64_t>(nowNs - scheduledNs, 0) / 1000);
+        stats.latency.record(latencyUs);
+        stats.intervalLatency.record(latencyUs);
+        stats.serviceLatency.record(uint64_t(max<int64_t>(nowNs - int64_t(verdict.timestampNs), 0) / 1000));
+
+        stats.received++;
+        stats.intervalReceived++;
+        stats.okCount += verdict.isOK ? 1 : 0;
+        stats.degradedCount += verdict.degraded ? 1 : 0;
+    }
+}
+
+static void printLatencySummary(const string &label, const LatencyHistogram &histogram)
+{
+    cout << label << " p50 " << histogram.percentile(50) / 1000.0 << "ms, p99 " << histogram.percentile(99) / 1000.0
+         << "ms, p99.9 " << histogram.percentile(99.9) / 1000.0 << "ms, max " << histogram.maxValue() / 1000.0 << "ms"
+         << " (" << histogram.count() << " 帧)" << endl;
+}
+
+static void printIntervalReport(double elapsedS, double intervalS, FrameRingProducer &ring,
+                                const SyntheticFramePool &pool, LoadStats &stats, const string &histogramFile)
+{
+    cout << fixed << setprecision(2);
+    cout << "[" << setprecision(0) << elapsedS << "s] 计划 " << stats.scheduled << ", 发布 " << ring.publishedFrames()
+         << ", 丢帧 " << ring.droppedFrames() << ", 判定 " << stats.received << ", 丢失判定 " << ring.lostResults()
+         << ", 吞吐 " << setprecision(1) << (intervalS > 0 ? stats.intervalReceived / intervalS : 0.0) << " fps"
+         << ", 已生成帧 " << pool.generated() << endl;
+    cout << setprecision(2);
+    printLatencySummary("  区间延迟", stats.intervalLatency);
+    printLatencySummary("  累计延迟", stats.latency);
+
+    stats.intervalLatency.reset();
+    stats.intervalReceived = 0;
+
+    // 每个区间覆盖写入，长时间运行中途中断也保留已有的分布
+    stats.latency.writePercentileDistribution(histogramFile, 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    auto printUsage = [&]()
+    {
+        cout << "Usage: " << argv[0] << " <image_folder> [--rate fps] [--arrival fixed|poisson] [--duration seconds]"
+             << " [--pool N] [--generators N] [--seed N] [--histogram file] [--ring ring_name]" << endl;
+        cout << "Example: " << argv[0] << " image_samples/2 --rate 20 --duration 7200" << endl;
+    };
+
+    if (argc < 2)
+    {
+        printUsage();
+        return -1;
+    }
+
+    string folder = argv[1];
+    double rate = LoadGeneratorConfig::DEFAULT_RATE;
+    bool poisson = false;
+    double durationS = 0.0; // 0 表示一直运行到 Ctrl+C
+    int poolSize = LoadGeneratorConfig::POOL_SIZE;
+    int generatorThreads = LoadGeneratorConfig::GENERATOR_THREADS;
+    unsigned seed = random_device{}();
+    string histogramFile = LoadGeneratorConfig::HISTOGRAM_FILE;
+    string ringName = FrameRingConfig::DEFAULT_RING_NAME;
+    for (int i = 2; i < argc; i += 2)
+    {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            // 末尾的选项没有值：不能静默忽略（例如 --duration 漏写时会变成一直运行）
+            cerr << "错误: 选项 " << arg << " 缺少参数值" << endl;
+            printUsage();
+            return -1;
+        }
+        string value = argv[i + 1];
+        if (arg == "--rate")
+        {
+            rate = atof(value.c_str());
+        }
+        else if (arg == "--arrival")
+        {
+            if (value != "fixed" && value != "poisson")
+            {
+                cerr << "错误: --arrival 应为 fixed 或 poisson" << endl;
+                return -1;
+            }
+            poisson = (value == "poisson");
+        }
+        else if (arg == "--duration")
+        {
+            durationS = atof(value.c_str());
+        }
+        else if (arg == "--pool")
+        {
+            poolSize = max(1, atoi(value.c_str()));
+        }
+        else if (arg == "--generators")
+        {
+            generatorThreads = max(0, atoi(value.c_str()));
+        }
+        else if (arg == "--seed")
+        {
+            seed = unsigned(strtoul(value.c_str(), nullptr, 10));
+        }
+        else if (arg == "--histogram")
+        {
+            histogramFile = value;
+        }
+        else if (arg == "--ring")
+        {
+            ringName = value;
+        }
+        else
+        {
+            cerr << "错误: 未知选项 " << arg << endl;
+            return -1;
+        }
+    }
+
+    vector<Mat> samples;
+    if (!loadSamples(folder, samples))
+    {
+        return -1;
+    }
+
+    int maxWidth = 0;
+    int maxHeight = 0;
+    for (const Mat &sample : samples)
+    {
+        maxWidth = max(maxWidth, sample.cols);
+        maxHeight = max(maxHeight, sample.rows);
+    }
+
+    cout << "生成帧池: " << poolSize << " 帧 (随机种子 " << seed << ")..." << endl;
+    SyntheticFramePool pool(samples, seed);
+    if (!pool.fill(poolSize))
+    {
+        return -1;
+    }
+
+    FrameRingProducer ring;
+    if (!ring.create(ringName, maxWidth, maxHeight))
+    {
+        return -1;
+    }
+
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    cout << "等待检测进程连接: tableware_detection --shm " << ringName << endl;
+    while (!ring.consumerAttached() && !g_stopRequested)
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    pool.start(generatorThreads);
+
+    if (rate > 0)
+    {
+        cout << "开环发送: " << (poisson ? "poisson" : "fixed") << " 到达, 目标 " << rate << " fps";
+    }
+    else
+    {
+        cout << "闭环发送: 未返回判定的帧少于 " << FrameRingConfig::SLOT_COUNT << " 时立即发送";
+    }
+    cout << ", 时长 " << (durationS > 0 ? to_string(int(durationS)) + "s" : string("不限 (Ctrl+C 结束)")) << endl;
+
+    mt19937 arrivalRng(seed ^ 0x9e3779b9u);
+    exponential_distribution<double> arrivalDist(rate > 0 ? rate : 1.0);
+    auto fixedInterval = chrono::duration<double>(rate > 0 ? 1.0 / rate : 0.0);
+
+    deque<pair<uint64_t, int64_t>> inFlight; // (帧序号, 计划发送时刻 ns)
+    LoadStats stats;
+
+    auto runStart = chrono::steady_clock::now();
+    auto runEnd = runStart + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(durationS));
+    auto nextSend = runStart;
+    auto nextReport = runStart + chrono::seconds(LoadGeneratorConfig::REPORT_INTERVAL_S);
+    auto lastReport = runStart;
+    size_t frameIndex = 0;
+
+    while (!g_stopRequested && (durationS <= 0 || chrono::steady_clock::now() < runEnd))
+    {
+        drainResults(ring, inFlight, stats);
+
+        auto now = chrono::steady_clock::now();
+        if (now >= nextReport)
+        {
+            printIntervalReport(chrono::duration<double>(now - runStart).count(),
+                                chrono::duration<double>(now - lastReport).count(), ring, pool, stats, histogramFile);
+            lastReport = now;
+            nextReport += chrono::seconds(LoadGeneratorConfig::REPORT_INTERVAL_S);
+        }
+
+        if (rate <= 0)
+        {
+            // 闭环：帧槽都有未返回的帧时等待判定
+            if (inFlight.size() >= size_t(FrameRingConfig::SLOT_COUNT))
+            {
+                this_thread::sleep_for(chrono::microseconds(FrameRingConfig::POLL_INTERVAL_US));
+                continue;
+            }
+            nextSend = now;
+        }
+        else if (now < nextSend)
+        {
+            // 开环：等待计划时刻，期间继续读取判定
+            this_thread::sleep_for(min<chrono::steady_clock::duration>(nextSend - now, chrono::milliseconds(1)));
+            continue;
+        }
+
+        int64_t scheduledNs = steadyNs(nextSend);
+        stats.scheduled++;
+        uint64_t sequence = 0;
+        if (ring.tryPush(pool.frame(frameIndex++), sequence))
+        {
+            inFlight.emplace_back(sequence, scheduledNs);
+        }
+
+        if (rate > 0)
+        {
+            // 计划时刻只由到达过程决定，发送落后时不顺延（落后的时间计入延迟）
+            double gapS = poisson ? arrivalDist(arrivalRng) : fixedInterval.count();
+            nextSend += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(gapS));
+        }
+    }
+
+    // 通知结束并等待剩余判定返回
+    ring.markDone();
+    pool.stop();
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(LoadGeneratorConfig::RESULT_TIMEOUT_S);
+    while (stats.received + ring.lostResults() < ring.publishedFrames() && chrono::steady_clock::now() < deadline)
+    {
+        drainResults(ring, inFlight, stats);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    double elapsedS = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+    uint64_t unanswered = ring.publishedFrames() - min(ring.publishedFrames(), stats.received + ring.lostResults());
+
+    cout << "====================================" << endl;
+    cout << fixed << setprecision(1);
+    cout << "运行 " << elapsedS << "s: 计划 " << stats.scheduled << " 帧, 发布 " << ring.publishedFrames()
+         << ", 丢帧(帧环满) " << ring.droppedFrames() << ", 丢失判定 " << ring.lostResults()
+         << ", 未返回 " << unanswered << endl;
+    cout << "收到判定: " << stats.received << " (OK " << stats.okCount << ", NG " << (stats.received - stats.okCount)
+         << ", 降级 " << stats.degradedCount << "), 平均吞吐 " << (elapsedS > 0 ? stats.received / elapsedS : 0.0)
+         << " fps, 生成帧 " << pool.generated() << endl;
+    cout << setprecision(2);
+    printLatencySummary("端到端延迟(自计划时刻)", stats.latency);
+    printLatencySummary("服务延迟(自写入帧环)", stats.serviceLatency);
+    if (stats.latency.writePercentileDistribution(histogramFile, 1000.0))
+    {
+        cout << "延迟分布(ms)已写入: " << histogramFile << endl;
+    }
+    cout << "====================================" << endl;
+    return 0;
+}
@@ -10,27 +10,864 @@
  * 使用方法：
  * tableware_detection.exe <image_path>
  * 例如：tableware_detection.exe tableware.jpg
+ *
+ * 共享内存输入模式（由相机进程提供原始帧，见 frame_producer）：
+ * tableware_detection.exe --shm [ring_name] [--budget ms]
+ *
+ * 预编译模板库（启动时直接 mmap，跳过模板文件夹扫描、解码和旋转；模板库与模板文件夹一致时跳过，--force 强制重新编译）：
+ * tableware_detection.exe compile-templates [output_file] [--force]
+ *
+ * 批量检测模式（--viewer 时在独立线程中实时显示最新结果，不拖慢检测；
+ * --memprofile 时输出分阶段内存统计并与基线比较，有回归时返回 1；
+ * --record-scores 时把每张图每个模板每个角度的得分追加写入得分库）：
+ * tableware_detection.exe --batch <image_folder> [--viewer] [--memprofile [baseline_file]] [--record-scores [score_file]]
+ *                         [--budget ms]
+ *
+ * 单帧延迟预算（--shm / --batch 加 --budget <ms>，见 latency_budget.h）：预算不够时按
+ * 跳过诊断统计 → 减少角度 → 粗缩放 的顺序降级，判定带降级标志和各阶段耗时。
+ *
+ * 工作线程拓扑（见 thread_topology.h）：--workers N（批量模式并行工作线程数）、
+ * --cv-threads T（每个工作线程的 OpenCV 线程数）、--affinity none|cores|numa|<CPU列表>，
+ * 结束时输出每个工作线程的上下文切换和运行队列等待。
+ *
+ * 运行指标（--shm / --batch 加 --metrics <file>，见 metrics.h）：定期把帧数、OK/NG、降级计数、
+ * 各阶段与各模板的延迟直方图和模板得分分布以 Prometheus 文本格式写入该文件。
+ *
+ * NG 证据留存（--shm / --batch 加 --evidence <folder> [--evidence-quota MB]，见 evidence_capture.h）：
+ * NG 帧的缩放图、二值图、final 和最佳匹配叠加图由后台线程写入该文件夹，超出配额时删除最旧的帧。
+ *
+ * 用新阈值重新判定得分库（不重新运行流水线）：
+ * tableware_detection.exe rejudge <score_file> [--thresholds t1,t2,...] [--labels labels_file]
+ *
+ * 多产品配方（recipes.txt，见 recipe.h）：以上检测模式均可加 --recipe <name> 选择初始配方；
+ * 共享内存模式下在控制台输入配方名即可换产（下一帧生效）。预编译某个配方的模板库：
+ * tableware_detection.exe compile-templates --recipe <name> [--force]
  */
 
 #include "image_processing.h"
 #include "display.h"
 #include "config_constants.h"
+#include "frame_ring.h"
+#include "viewer.h"
+#include "memory_accounting.h"
+#include "score_store.h"
+#include "recipe.h"
+#include "thread_topology.h"
+#include "metrics.h"
+#include "evidence_capture.h"
+#include "image_files.h"
 #include <iostream>
 #include <string>
 #include <cstdlib>
 #include <chrono>
+#include <thread>
 #include <sstream>
-#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 using namespace cv;
 using namespace std;
+namespace fs = std::filesystem;
+
+// 预编译模板库：扫描模板文件夹，解码、预旋转并写入二进制文件（模板库与模板文件夹一致且未指定 force 时跳过）
+static int compileTemplates(const string &templateFolder, const vector<double> &thresholds, const string &outputPath,
+                            bool force)
+{
+    if (outputPath.empty())
+    {
+        cerr << "错误: 没有指定模板库输出文件" << endl;
+        return -1;
+    }
+
+    string reason;
+    if (!force && templateBankUpToDate(outputPath, templateFolder, reason))
+    {
+        cout << "模板库 " << outputPath << " 与模板文件夹一致，跳过编译（--force 强制重新编译）" << endl;
+        return 0;
+    }
+    if (!force)
+    {
+        cout << "重新编译模板库 " << outputPath << ": " << reason << endl;
+    }
+
+    TemplateBank bank;
+    if (!buildTemplateBank(templateFolder, thresholds, bank))
+    {
+        return -1;
+    }
+
+    if (!saveTemplateBank(bank, outputPath))
+    {
+        return -1;
+    }
+
+    size_t variantCount = 0;
+    for (const TemplateEntry &entry : bank.templates)
+    {
+        variantCount += entry.variants.size();
+    }
+
+    cout << "模板库已写入 " << outputPath << ": " << bank.templates.size() << " 个模板, "
+         << variantCount << " 个旋转变体" << endl;
+    return 0;
+}
+
+// 预编译配方文件中某个配方的模板库（写入该配方的 template_bank）
+static int compileRecipeTemplates(const string &recipeName, bool force)
+{
+    vector<Recipe> recipes;
+    if (!readRecipeDefinitions(RecipeConfig::RECIPE_FILE, recipes))
+    {
+        return -1;
+    }
+
+    for (const Recipe &recipe : recipes)
+    {
+        if (recipe.name == recipeName)
+        {
+            return compileTemplates(recipe.templateFolder, recipe.thresholds, recipe.templateBankFile, force);
+        }
+    }
+
+    cerr << "错误: 未知配方 \"" << recipeName << "\"" << endl;
+    return -1;
+}
+
+// 准备所有配方的模板库（预编译文件优先，否则扫描模板文件夹），并选择初始配方
+static bool prepareRecipes(RecipeSet &recipes, const string &initialRecipe)
+{
+    if (!recipes.load(RecipeConfig::RECIPE_FILE))
+    {
+        return false;
+    }
+    return initialRecipe.empty() || recipes.select(initialRecipe);
+}
+
+// 换产控制线程：从标准输入读取配方名并切换活动配方
+static void recipeControlLoop(shared_ptr<RecipeSet> recipes)
+{
+    string line;
+    while (getline(cin, line))
+    {
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty())
+        {
+            recipes->select(line);
+        }
+    }
+}
+
+// 换产控制：后台线程读取控制台输入切换配方（下一帧生效）
+static void startRecipeControl(const shared_ptr<RecipeSet> &recipes)
+{
+    if (recipes->recipes().size() < 2)
+    {
+        return;
+    }
+
+    cout << "换产: 输入配方名并回车即可切换，可用配方:";
+    for (const Recipe &recipe : recipes->recipes())
+    {
+        cout << " " << recipe.name;
+    }
+    cout << endl;
+
+    // 阻塞在标准输入上，无法主动唤醒，因此分离线程；配方集由 shared_ptr 保持存活
+    thread(recipeControlLoop, recipes).detach();
+}
+
+// 解析 --budget 的毫秒数（0 表示关闭预算）；拼写错误不能被当成 0 静默关闭预算
+static bool parseBudgetMs(const string &text, double &budgetMs)
+{
+    char *end = nullptr;
+    double value = strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || !(value >= 0.0 && value <= 60000.0))
+    {
+        cerr << "错误: --budget 应为 0~60000 之间的毫秒数: \"" << text << "\"" << endl;
+        return false;
+    }
+    budgetMs = value;
+    return true;
+}
+
+// 共享内存输入模式：直接在相机进程的帧槽上运行流水线，判定写回结果环
+static int runSharedMemoryIngest(const string &ringName, const string &initialRecipe, double budgetMs,
+                                 ThreadTopology topology, EvidenceCapture *evidence)
+{
+    // 帧环只有一个消费者，检测在本线程中进行
+    if (topology.workers > 1)
+    {
+        cerr << "警告: 共享内存模式只有一个工作线程，忽略 --workers" << endl;
+        topology.workers = 1;
+    }
+
+    auto recipes = make_shared<RecipeSet>();
+    if (!prepareRecipes(*recipes, initialRecipe))
+    {
+        return -1;
+    }
+
+    // 无界面运行：只保留模板匹配需要的 final；留存 NG 证据时还需要缩放图和二值图
+    StageGraph graph;
+    if (!buildDetectionGraph(evidence != nullptr, graph))
+    {
+        return -1;
+    }
+
+    FrameRingConsumer ring;
+    if (!ring.attach(ringName, FrameRingConfig::ATTACH_TIMEOUT_MS))
+    {
+        return -1;
+    }
+
+    uint64_t processed = 0;
+    uint64_t okCount = 0;
+    uint64_t degradedCount = 0;
+    const Recipe *lastRecipe = nullptr;
+    LatencyBudgetController budgetController(budgetMs);
+
+    startRecipeControl(recipes);
+
+    // 在换产控制线程启动之后绑定，控制线程不继承本线程的 CPU 绑定
+    printTopologyPlan(topology);
+    WorkerSchedReport sched;
+    sched.cpus = applyWorkerTopology(topology, 0);
+    sched.start = sampleCurrentThread();
+
+    while (!ring.finished())
+    {
+        Mat frame;
+        uint64_t sequence = 0;
+        uint64_t timestampNs = 0;
+        if (!ring.acquire(frame, sequence, timestampNs))
+        {
+            // 生产者异常退出时不会标记结束，心跳超时后退出，不再无限等待
+            if (ring.producerLost(FrameRingConfig::PRODUCER_TIMEOUT_MS))
+            {
+                cerr << "错误: 生产者已 " << FrameRingConfig::PRODUCER_TIMEOUT_MS
+                     << "ms 没有活动，视为已退出" << endl;
+                break;
+            }
+            this_thread::sleep_for(chrono::microseconds(FrameRingConfig::POLL_INTERVAL_US));
+            continue;
+        }
+
+        auto algorithmStart = chrono::steady_clock::now();
+
+        // 预算从生产者发布帧的时刻算起（同一台机器上的 steady_clock），环中排队的时间也计入
+        auto frameStart = chrono::steady_clock::time_point(
+            chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(timestampNs)));
+        FrameBudget budget = budgetController.beginFrame(frameStart);
+
+        // 每帧开始时取一次活动配方，换产从下一帧开始生效，不会在一帧内混用
+        const Recipe &recipe = recipes->active();
+        if (&recipe != lastRecipe)
+        {
+            cout << "[帧 " << sequence << "] 使用配方: " << recipe.name << endl;
+            lastRecipe = &recipe;
+        }
+
+        DetectionPipelineResult result;
+        bool isOK = runDetectionPipeline(frame, recipe, graph, result, false, DecodedImageInfo(), &budget);
+
+        // 流水线已不再引用帧槽（缩放结果是独立内存），立即归还给生产者
+        frame.release();
+        ring.release();
+
+        auto algorithmEnd = chrono::steady_clock::now();
+        budgetController.endFrame(budget);
+
+        FrameVerdict verdict;
+        verdict.sequence = sequence;
+        verdict.timestampNs = timestampNs;
+        verdict.processingUs = uint32_t(chrono::duration_cast<chrono::microseconds>(algorithmEnd - algorithmStart).count());
+        verdict.isOK = isOK;
+        for (const auto &match : result.matchResults)
+        {
+            verdict.scores.push_back(float(match.score));
+            verdict.angles.push_back(float(match.bestAngle));
+        }
+        verdict.degraded = result.degraded;
+        verdict.degradeLevel = uint32_t(result.degradeLevel);
+        for (const auto &stage : result.stageMs)
+        {
+            verdict.stageMs.emplace_back(stage.first, float(stage.second));
+        }
+        ring.publishResult(verdict);
+        recordFrameMetrics(result, verdict.processingUs / 1000.0);
+        if (!isOK && evidence)
+        {
+            evidence->submit(makeEvidenceFrame("frame_" + to_string(sequence), result, recipe.bank));
+        }
+
+        processed++;
+        sched.frames++;
+        okCount += isOK ? 1 : 0;
+        degradedCount += result.degraded ? 1 : 0;
+        cout << "[帧 " << sequence << "] 判定: " << (isOK ? "OK" : "NG")
+             << ", Algorithm time: " << verdict.processingUs / 1000.0 << "ms";
+        if (result.degraded)
+        {
+            cout << " (降级: " << degradeLevelName(result.degradeLevel)
+                 << (budget.anglesCut() ? ", 少测角度" : "") << ")";
+        }
+        cout << endl;
+    }
+
+    sched.end = sampleCurrentThread();
+
+    cout << "====================================" << endl;
+    cout << "共享内存输入结束: 处理 " << processed << " 帧, OK " << okCount
+         << ", NG " << (processed - okCount) << ", 降级 " << degradedCount << endl;
+    graph.printTimings();
+    budgetController.printSummary();
+    printWorkerSchedReports(topology, {sched});
+    return 0;
+}
+
+// 批量检测选项
+struct BatchOptions
+{
+    bool withViewer = false;  // 独立线程实时显示
+    string memoryBaseline;    // 非空时输出分阶段内存统计并与该基线比较
+    string scoreFile;         // 非空时追加写入得分库
+    string recipe;            // 初始配方（空为配方文件中第一个）
+    double budgetMs = LatencyBudgetConfig::DEFAULT_BUDGET_MS;
+    ThreadTopology topology;  // 工作线程数、OpenCV 线程数与绑定
+    EvidenceCapture *evidence = nullptr; // 非空时提交 NG 帧的证据
+};
+
+// 批量检测的共享状态：图片按原子下标分给各工作线程，逐帧输出和结果汇总在锁内进行
+struct BatchRun
+{
+    BatchOptions options;
+    vector<string> files;
+    const Recipe *recipe = nullptr;
+    ScoreStoreWriter scoreStore;
+    DetectionViewer viewer;
+    atomic<size_t> nextFile{0};
+
+    mutex reportMutex; // 保护以下统计、控制台逐帧输出、得分库和查看器投递
+    int processed = 0;
+    int okCount = 0;
+    int degradedCount = 0;
+};
+
+// 每个工作线程独立的流水线（节点耗时统计不共享）、预算控制器和调度统计
+struct BatchWorker
+{
+    explicit BatchWorker(double budgetMs) : budgetController(budgetMs) {}
+
+    StageGraph graph;
+    LatencyBudgetController budgetController;
+    WorkerSchedReport sched;
+};
+
+static void runBatchWorker(BatchRun &run, BatchWorker &worker)
+{
+    worker.sched.cpus = applyWorkerTopology(run.options.topology, worker.sched.worker);
+    worker.sched.start = sampleCurrentThread();
+
+    bool recordScores = !run.options.scoreFile.empty();
+    bool withViewer = run.options.withViewer;
+
+    for (size_t index = run.nextFile++; index < run.files.size(); index = run.nextFile++)
+    {
+        const string &file = run.files[index];
+        auto totalStart = chrono::steady_clock::now();
+
+        Mat originalImage;
+        DecodedImageInfo decodeInfo;
+        {
+            MemoryStageScope stage(MemoryStage::Decode);
+            originalImage = decodeImageForDetection(file, Config::DECODE_REDUCTION, decodeInfo);
+        }
+        if (originalImage.empty())
+        {
+            cerr << "警告: 无法加载图片 " << file << "，已跳过" << endl;
+            continue;
+        }
+
+        // 多个工作线程时本帧的诊断输出先写入缓冲区，与判定一起在输出锁内打印
+        ostringstream frameOutput;
+        unique_ptr<FrameLogCapture> capture;
+        if (run.options.topology.workers > 1)
+        {
+            capture = make_unique<FrameLogCapture>(frameOutput);
+        }
+
+        auto algorithmStart = chrono::steady_clock::now();
+        FrameBudget budget = worker.budgetController.beginFrame(totalStart); // 解码也计入预算
+        DetectionPipelineResult pipeline;
+        bool isOK = runDetectionPipeline(originalImage, *run.recipe, worker.graph, pipeline, recordScores,
+                                         decodeInfo, &budget);
+        capture.reset();
+        auto algorithmEnd = chrono::steady_clock::now();
+        worker.budgetController.endFrame(budget);
+        worker.sched.frames++;
+        recordFrameMetrics(pipeline, chrono::duration<double, milli>(algorithmEnd - totalStart).count());
+
+        int algorithmMs = chrono::duration_cast<chrono::milliseconds>(algorithmEnd - algorithmStart).count();
+        int totalMs = chrono::duration_cast<chrono::milliseconds>(algorithmEnd - totalStart).count();
+        string name = fs::path(file).filename().string();
+
+        // 证据在查看器取走匹配结果之前提交（只移交图像引用，编码写盘在证据线程中进行）
+        if (!isOK && run.options.evidence)
+        {
+            run.options.evidence->submit(makeEvidenceFrame(name, pipeline, run.recipe->bank));
+        }
+
+        Mat displayOriginal;
+        if (withViewer && run.viewer.running())
+        {
+            applyExifOrientation(originalImage, displayOriginal, decodeInfo.exifOrientation);
+        }
+
+        lock_guard<mutex> lock(run.reportMutex);
+        run.processed++;
+        run.okCount += isOK ? 1 : 0;
+        run.degradedCount += pipeline.degraded ? 1 : 0;
+        cout << frameOutput.str();
+        cout << "[" << name << "] 判定: " << (isOK ? "OK" : "NG")
+             << ", Algorithm time: " << algorithmMs << "ms";
+        if (pipeline.degraded)
+        {
+            cout << " (降级: " << degradeLevelName(pipeline.degradeLevel)
+                 << (budget.anglesCut() ? ", 少测角度" : "") << ")";
+        }
+        if (run.options.topology.workers > 1)
+        {
+            cout << " [工作线程 " << worker.sched.worker << "]";
+        }
+        cout << endl;
+
+        if (recordScores)
+        {
+            run.scoreStore.append(name, pipeline.matchResults, isOK);
+        }
+
+        // 把本帧结果交给查看器（只移交引用，查看器来不及显示的帧会被下一帧覆盖）
+        if (!displayOriginal.empty())
+        {
+            auto frame = make_shared<ViewerFrame>();
+            frame->name = name;
+            frame->panels = {displayOriginal, pipeline.resizedImage, pipeline.originalBinary,
+                             pipeline.morphProcessed, pipeline.contourFilled, pipeline.finalResult};
+            frame->matchResults = move(pipeline.matchResults);
+            frame->isOK = isOK;
+            frame->algorithmMs = algorithmMs;
+            frame->totalMs = totalMs;
+            run.viewer.post(move(frame));
+        }
+    }
+
+    worker.sched.end = sampleCurrentThread();
+}
+
+// 批量检测模式：模板库只加载一次，由工作线程逐张检测；显示交给查看器线程
+static int runBatch(const string &folder, BatchOptions options)
+{
+    bool memoryProfile = !options.memoryBaseline.empty();
+    bool recordScores = !options.scoreFile.empty();
+
+    // 得分库需要每个角度的完整得分，降级会让记录不完整
+    if (recordScores && options.budgetMs > 0.0)
+    {
+        cerr << "警告: --record-scores 时忽略 --budget，每帧按完整流程处理" << endl;
+        options.budgetMs = 0.0;
+    }
+
+    // 分阶段内存峰值是进程级统计，多个工作线程同时运行时无法区分
+    if (memoryProfile && options.topology.workers > 1)
+    {
+        cerr << "警告: --memprofile 时只使用 1 个工作线程" << endl;
+        options.topology.workers = 1;
+    }
+
+    if (!checkTopology(options.topology))
+    {
+        return -1;
+    }
+
+    BatchRun run;
+    run.options = options;
+    if (!listImageFiles(folder, run.files))
+    {
+        return -1;
+    }
+    if (run.files.empty())
+    {
+        cerr << "错误: 文件夹中没有图片: " << folder << endl;
+        return -1;
+    }
+
+    RecipeSet recipes;
+    if (!prepareRecipes(recipes, options.recipe))
+    {
+        return -1;
+    }
+    run.recipe = &recipes.active();
+
+    // 只有查看器和 NG 证据需要中间图；都不需要时跳过不需要的节点
+    vector<unique_ptr<BatchWorker>> workers;
+    for (int i = 0; i < options.topology.workers; i++)
+    {
+        workers.push_back(make_unique<BatchWorker>(options.budgetMs));
+        workers.back()->sched.worker = i;
+        if (!buildDetectionGraph(options.withViewer || options.evidence, workers.back()->graph))
+        {
+            return -1;
+        }
+    }
+
+    // 得分库：记录所有角度的得分（匹配时不早停，判定不变）
+    if (recordScores && !run.scoreStore.open(options.scoreFile, run.recipe->bank))
+    {
+        return -1;
+    }
+
+    if (options.withViewer)
+    {
+        run.viewer.start("HSV Detection and Processing");
+    }
+
+    printTopologyPlan(options.topology);
+
+    // 模板库和查看器准备完成后再开始统计，只统计逐帧检测
+    if (memoryProfile)
+    {
+        enableMemoryAccounting();
+    }
+
+    auto batchStart = chrono::steady_clock::now();
+
+    vector<thread> threads;
+    for (auto &worker : workers)
+    {
+        threads.emplace_back(runBatchWorker, ref(run), ref(*worker));
+    }
+    for (thread &workerThread : threads)
+    {
+        workerThread.join();
+    }
+
+    int batchMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - batchStart).count();
+
+    vector<MemoryStageStats> memoryStats;
+    if (memoryProfile)
+    {
+        memoryStats = memoryStageSnapshot();
+        disableMemoryAccounting();
+    }
+
+    cout << "====================================" << endl;
+    cout << "批量检测结束: 处理 " << run.processed << " 张, OK " << run.okCount
+         << ", NG " << (run.processed - run.okCount) << ", 总耗时 " << batchMs << "ms" << endl;
+    if (options.budgetMs > 0.0)
+    {
+        cout << "降级处理: " << run.degradedCount << " 张" << endl;
+    }
+    if (options.withViewer)
+    {
+        cout << "查看器: 显示 " << run.viewer.renderedFrames() << " 帧, 跳过 " << run.viewer.skippedFrames() << " 帧" << endl;
+    }
+    if (recordScores)
+    {
+        cout << "得分库: 追加 " << run.scoreStore.appended() << " 条记录到 " << options.scoreFile << endl;
+    }
+
+    vector<WorkerSchedReport> schedReports;
+    for (const auto &worker : workers)
+    {
+        if (workers.size() > 1)
+        {
+            cout << "工作线程 " << worker->sched.worker << ":" << endl;
+        }
+        worker->graph.printTimings();
+        worker->budgetController.printSummary();
+        schedReports.push_back(worker->sched);
+    }
+    printWorkerSchedReports(options.topology, schedReports);
+
+    bool memoryOK = true;
+    if (memoryProfile)
+    {
+        memoryOK = reportMemoryStages(memoryStats, run.processed, options.memoryBaseline,
+                                      MemoryAccountingConfig::REGRESSION_TOLERANCE);
+    }
+
+    // 保持最后一帧显示，按任意键退出
+    run.viewer.stop(true);
+    return memoryOK ? 0 : 1;
+}
+
+// --metrics / --evidence 指定的后台输出（批量和共享内存模式共用）
+struct BackgroundOutputs
+{
+    string metricsFile;
+    string evidenceFolder;
+    int evidenceQuotaMb = EvidenceConfig::DEFAULT_QUOTA_MB;
+    EvidenceCapture evidence;
+};
+
+static bool startBackgroundOutputs(BackgroundOutputs &outputs)
+{
+    if (!outputs.metricsFile.empty() &&
+        !startMetricsExport(outputs.metricsFile, MetricsConfig::WRITE_INTERVAL_S))
+    {
+        return false;
+    }
+
+    if (!outputs.evidenceFolder.empty())
+    {
+        if (!outputs.evidence.start(outputs.evidenceFolder, uint64_t(outputs.evidenceQuotaMb) * 1024 * 1024,
+                                    EvidenceConfig::QUEUE_CAPACITY))
+        {
+            stopMetricsExport();
+            return false;
+        }
+
+        if (metricsEnabled())
+        {
+            EvidenceCapture *evidence = &outputs.evidence;
+            registerMetricsValue("tableware_evidence_queue_depth", "gauge", "NG evidence frames waiting to be written.",
+                                 [evidence] { return double(evidence->queueDepth()); });
+            registerMetricsValue("tableware_evidence_written_total", "counter", "NG evidence frames written to disk.",
+                                 [evidence] { return double(evidence->writtenFrames()); });
+            registerMetricsValue("tableware_evidence_dropped_total", "counter", "NG evidence frames dropped because the queue was full.",
+                                 [evidence] { return double(evidence->droppedFrames()); });
+            registerMetricsValue("tableware_evidence_evicted_total", "counter", "NG evidence frames deleted to stay within the disk quota.",
+                                 [evidence] { return double(evidence->evictedFrames()); });
+            registerMetricsValue("tableware_evidence_write_errors_total", "counter", "NG evidence frames that failed to encode or write.",
+                                 [evidence] { return double(evidence->writeErrors()); });
+            registerMetricsValue("tableware_evidence_disk_bytes", "gauge", "Disk space used by NG evidence.",
+                                 [evidence] { return double(evidence->diskBytes()); });
+        }
+    }
+    return true;
+}
+
+// 先写完剩余证据，再写最终指标（包含最终的证据计数）
+static void stopBackgroundOutputs(BackgroundOutputs &outputs)
+{
+    if (outputs.evidence.running())
+    {
+        outputs.evidence.stop();
+        outputs.evidence.printSummary();
+    }
+    stopMetricsExport();
+}
 
 int main(int argc, char *argv[])
 {
+    // --recipe <name>、--metrics <file>、--evidence <folder> 和工作线程拓扑选项可出现在任意位置：
+    // 取出后从参数列表中去掉，其余参数按原格式解析
+    string recipeName;
+    BackgroundOutputs outputs;
+    ThreadTopology topology;
+    vector<char *> arguments;
+    for (int i = 0; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = (i > 0 && i + 1 < argc);
+        if (hasValue && arg == "--recipe")
+        {
+            recipeName = argv[++i];
+            continue;
+        }
+        if (hasValue && arg == "--metrics")
+        {
+            outputs.metricsFile = argv[++i];
+            continue;
+        }
+        if (hasValue && arg == "--evidence")
+        {
+            outputs.evidenceFolder = argv[++i];
+            continue;
+        }
+        if (hasValue && arg == "--evidence-quota")
+        {
+            outputs.evidenceQuotaMb = atoi(argv[++i]);
+            if (outputs.evidenceQuotaMb <= 0)
+            {
+                cerr << "错误: --evidence-quota 应为正整数（MB）" << endl;
+                return -1;
+            }
+            continue;
+        }
+        if (hasValue && arg == "--workers")
+        {
+            topology.workers = atoi(argv[++i]);
+            if (topology.workers < 1 || topology.workers > ThreadTopologyConfig::MAX_WORKERS)
+            {
+                cerr << "错误: --workers 应在 1-" << ThreadTopologyConfig::MAX_WORKERS << " 之间" << endl;
+                return -1;
+            }
+            continue;
+        }
+        if (hasValue && arg == "--cv-threads")
+        {
+            topology.cvThreads = atoi(argv[++i]);
+            continue;
+        }
+        if (hasValue && arg == "--affinity")
+        {
+            if (!parseAffinitySpec(argv[++i], topology))
+            {
+                return -1;
+            }
+            continue;
+        }
+        arguments.push_back(argv[i]);
+    }
+    argc = int(arguments.size());
+    argv = arguments.data();
+
+    // 批量检测模式
+    if (argc >= 3 && string(argv[1]) == "--batch")
+    {
+        BatchOptions options;
+        options.recipe = recipeName;
+        options.topology = topology;
+        for (int i = 3; i < argc; i++)
+        {
+            string arg = argv[i];
+            // 可选的文件路径紧跟在选项之后
+            bool hasPath = (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0);
+            if (arg == "--viewer")
+            {
+                options.withViewer = true;
+            }
+            else if (arg == "--memprofile")
+            {
+                options.memoryBaseline = hasPath ? argv[++i] : MemoryAccountingConfig::BASELINE_FILE;
+            }
+            else if (arg == "--record-scores")
+            {
+                options.scoreFile = hasPath ? argv[++i] : ScoreStoreConfig::DEFAULT_FILE;
+            }
+            else if (arg == "--budget" && hasPath)
+            {
+                if (!parseBudgetMs(argv[++i], options.budgetMs))
+                {
+                    return -1;
+                }
+            }
+        }
+        if (!startBackgroundOutputs(outputs))
+        {
+            return -1;
+        }
+        options.evidence = outputs.evidence.running() ? &outputs.evidence : nullptr;
+        int exitCode = runBatch(argv[2], options);
+        stopBackgroundOutputs(outputs);
+        return exitCode;
+    }
+
+    // 用新阈值重新判定得分库
+    if (argc >= 3 && string(argv[1]) == "rejudge")
+    {
+        vector<double> thresholds = TemplateMatchConfig::THRESHOLDS;
+        string labelsFile;
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            string arg = argv[i];
+            if (arg == "--labels")
+            {
+                labelsFile = argv[i + 1];
+            }
+            else if (arg == "--thresholds")
+            {
+                thresholds.clear();
+                stringstream ss(argv[i + 1]);
+                string value;
+                while (getline(ss, value, ','))
+                {
+                    // 与配方阈值相同的校验：拼写错误不能被当成 0 静默接受
+                    char *end = nullptr;
+                    double threshold = strtod(value.c_str(), &end);
+                    if (value.empty() || *end != '\0' || !(threshold >= 0.0 && threshold <= 1.0))
+                    {
+                        cerr << "错误: --thresholds 的阈值应为 0~1 之间的数: \"" << value << "\"" << endl;
+                        return -1;
+                    }
+                    thresholds.push_back(threshold);
+                }
+            }
+        }
+        return rejudgeScoreStore(argv[2], labelsFile, thresholds) ? 0 : -1;
+    }
+
+    // 共享内存输入模式
+    if (argc >= 2 && string(argv[1]) == "--shm")
+    {
+        string ringName = FrameRingConfig::DEFAULT_RING_NAME;
+        double budgetMs = LatencyBudgetConfig::DEFAULT_BUDGET_MS;
+        for (int i = 2; i < argc; i++)
+        {
+            string arg = argv[i];
+            if (arg == "--budget" && i + 1 < argc)
+            {
+                if (!parseBudgetMs(argv[++i], budgetMs))
+                {
+                    return -1;
+                }
+            }
+            else
+            {
+                ringName = arg;
+            }
+        }
+        if (!startBackgroundOutputs(outputs))
+        {
+            return -1;
+        }
+        EvidenceCapture *evidence = outputs.evidence.running() ? &outputs.evidence : nullptr;
+        int exitCode = runSharedMemoryIngest(ringName, recipeName, budgetMs, topology, evidence);
+        stopBackgroundOutputs(outputs);
+        return exitCode;
+    }
+
+    // 预编译模板库
+    if (argc >= 2 && string(argv[1]) == "compile-templates")
+    {
+        bool force = false;
+        string outputPath = TemplateMatchConfig::TEMPLATE_BANK_FILE;
+        for (int i = 2; i < argc; i++)
+        {
+            if (string(argv[i]) == "--force")
+            {
+                force = true;
+            }
+            else
+            {
+                outputPath = argv[i];
+            }
+        }
+        if (!recipeName.empty())
+        {
+            return compileRecipeTemplates(recipeName, force);
+        }
+        return compileTemplates(TemplateMatchConfig::TEMPLATE_FOLDER, TemplateMatchConfig::THRESHOLDS, outputPath, force);
+    }
+
     // Check command line arguments
     if (argc != 2)
     {
         cout << "Usage: " << argv[0] << " <image_path>" << endl;
+        cout << "       " << argv[0] << " --shm [ring_name] [--budget ms]" << endl;
+        cout << "       " << argv[0] << " compile-templates [output_file] [--force] | --recipe <name> [--force]" << endl;
+        cout << "       " << argv[0] << " --batch <image_folder> [--viewer] [--memprofile [baseline_file]]"
+             << " [--record-scores [score_file]] [--budget ms]" << endl;
+        cout << "       " << argv[0] << " rejudge <score_file> [--thresholds t1,t2,...] [--labels labels_file]" << endl;
+        cout << "       检测模式均可加 --recipe <name> 选择配方（" << RecipeConfig::RECIPE_FILE << "）" << endl;
+        cout << "       --shm / --batch 可加 [--workers N] [--cv-threads T] [--affinity none|cores|numa|0-3,8]" << endl;
+        cout << "       --shm / --batch 可加 [--metrics file.prom] 导出 Prometheus 指标" << endl;
+        cout << "       --shm / --batch 可加 [--evidence folder] [--evidence-quota MB] 留存 NG 证据" << endl;
         cout << "Example: " << argv[0] << " tableware.jpg" << endl;
         system("pause");
         return -1;
@@ -41,8 +878,25 @@ int main(int argc, char *argv[])
     // 开始总计时
     auto totalStart = chrono::steady_clock::now();
 
-    // 读取图像
-    Mat originalImage = imread(imagePath, IMREAD_COLOR);
+    // 准备配方及其模板库（预编译文件存在时直接 mmap）
+    RecipeSet recipes;
+    if (!prepareRecipes(recipes, recipeName))
+    {
+        system("pause");
+        return -1;
+    }
+
+    // 按配置构建流水线（保留中间结果用于显示）
+    StageGraph graph;
+    if (!buildDetectionGraph(true, graph))
+    {
+        system("pause");
+        return -1;
+    }
+
+    // 读取图像（EXIF 方向在缩放后的小图上应用）
+    DecodedImageInfo decodeInfo;
+    Mat originalImage = decodeImageForDetection(imagePath, Config::DECODE_REDUCTION, decodeInfo);
 
     // Check if image is loaded successfully
     if (originalImage.empty())
@@ -58,40 +912,16 @@ int main(int argc, char *argv[])
     // =====================================================
     auto algorithmStart = chrono::steady_clock::now();
 
-    // 先缩放原图
-    Mat resizedImage = resizeImageByScale(originalImage, Config::RESIZE_SCALE);
-
-    // 直接使用缩放后的图像进行处理
-    Mat rgbImage = resizedImage.clone();
-
-    // =====================================================
-    // 图像处理流水线
-    // =====================================================
-
-    // 1. 创建HSV二值化结果
-    Mat originalBinary = createHueBinaryMask(rgbImage);
-
-    // 2. 形态学处理
-    Mat morphProcessed = performMorphological(originalBinary);
-
-    // 3. 轮廓填充处理
-    Mat contourFilled = fillContours(morphProcessed);
+    // 执行检测流水线（按节点图预处理 → 模板匹配）
+    DetectionPipelineResult pipeline;
+    bool isOK = runDetectionPipeline(originalImage, recipes.active(), graph, pipeline, false, decodeInfo);
 
-    // 4. 连通域百分比过滤处理（基于全图面积百分比过滤）
-    Mat finalResult = filterConnectedComponentsByPercent(contourFilled, Config::CONNECTED_COMPONENT_PERCENT);
-
-    // =====================================================
-    // 模板匹配判断 NG/OK
-    // =====================================================
-
-    cout << "\n========== 模板匹配判断 ==========" << endl;
-
-    vector<TemplateMatchResult> matchResults;
-    bool isOK = judgeByTemplateMatch(
-        finalResult,
-        TemplateMatchConfig::TEMPLATE_FOLDER,
-        TemplateMatchConfig::THRESHOLDS,
-        matchResults);
+    Mat &resizedImage = pipeline.resizedImage;
+    Mat &originalBinary = pipeline.originalBinary;
+    Mat &morphProcessed = pipeline.morphProcessed;
+    Mat &contourFilled = pipeline.contourFilled;
+    Mat &finalResult = pipeline.finalResult;
+    vector<TemplateMatchResult> &matchResults = pipeline.matchResults;
 
     // 算法处理完成（包含判断逻辑），记录结束时间
     auto algorithmEnd = chrono::steady_clock::now();
@@ -114,13 +944,16 @@ int main(int argc, char *argv[])
     // =====================================================
 
     // 显示6张图片：原图，缩放图，二值图，形态学处理，轮廓填充，连通域过滤
+    Mat displayOriginal;
+    applyExifOrientation(originalImage, displayOriginal, decodeInfo.exifOrientation);
+
     vector<Mat> displayImages = {
-        originalImage,  // 1. 原始BGR图像（未缩放）
-        resizedImage,   // 2. 缩放后的图像
-        originalBinary, // 3. HSV二值化图像
-        morphProcessed, // 4. 形态学处理结果
-        contourFilled,  // 5. 轮廓填充结果
-        finalResult     // 6. 连通域百分比过滤结果
+        displayOriginal, // 1. 原始BGR图像（未缩放，按EXIF方向显示）
+        resizedImage,    // 2. 缩放后的图像
+        originalBinary,  // 3. HSV二值化图像
+        morphProcessed,  // 4. 形态学处理结果
+        contourFilled,   // 5. 轮廓填充结果
+        finalResult      // 6. 连通域百分比过滤结果
     };
 
     vector<string> displayTitles = {
@@ -131,55 +964,9 @@ int main(int argc, char *argv[])
         "5. Contour Filled",
         "6. Final Result"};
 
-    // 创建subplot显示 (2行3列布局，显示6张处理步骤图)
-    Mat subplotCanvas = createSubplotDisplay(displayImages, displayTitles, 2, 3);
-
-    // 扩大画布，在底部增加文字显示区域
-    int textAreaHeight = 150; // 底部文字区域高度
-    Mat extendedCanvas(subplotCanvas.rows + textAreaHeight, subplotCanvas.cols, CV_8UC3, Scalar(40, 40, 40));
-    subplotCanvas.copyTo(extendedCanvas(Rect(0, 0, subplotCanvas.cols, subplotCanvas.rows)));
-
-    // 在扩展画布左上角显示处理时间
-    putText(extendedCanvas, "Algorithm: " + to_string(algorithmMs) + "ms", Point(10, 30),
-            FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
-    putText(extendedCanvas, "Total: " + to_string(totalMs) + "ms", Point(10, 60),
-            FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
-
-    // 在扩展画布底部专门区域显示模板匹配结果
-    int textStartY = subplotCanvas.rows + 30; // 文字起始Y坐标
-    for (size_t i = 0; i < matchResults.size(); ++i)
-    {
-        // 格式化显示：最佳相似度=X.XXX (角度=X.X°)
-        stringstream ss;
-        ss << fixed << setprecision(3) << matchResults[i].score;
-        string scoreStr = ss.str();
-        ss.str("");
-        ss << fixed << setprecision(1) << matchResults[i].bestAngle;
-        string angleStr = ss.str();
-
-        string statusText = "no." + to_string(i + 1) + ":" + (matchResults[i].passed ? "ok" : "ng") +
-                            " similarity=" + scoreStr + " (angle=" + angleStr + "deg)";
-        Scalar statusColor = matchResults[i].passed ? Scalar(255, 0, 0) : Scalar(0, 0, 255); // 蓝色=OK, 红色=NG
-        putText(extendedCanvas, statusText, Point(10, textStartY + int(i * 35)),
-                FONT_HERSHEY_COMPLEX, 0.7, statusColor, 2);
-    }
-
-    // 在画布右上角显示 OK/NG 判定结果
-    string judgementText = isOK ? "OK" : "NG";
-    Scalar judgementColor = isOK ? Scalar(0, 255, 0) : Scalar(0, 0, 255); // 绿色=OK, 红色=NG
-
-    // 计算文本尺寸以便右对齐
-    int fontFace = FONT_HERSHEY_SIMPLEX;
-    double fontScale = 2.5;
-    int thickness = 5;
-    int baseline = 0;
-    Size textSize = getTextSize(judgementText, fontFace, fontScale, thickness, &baseline);
-
-    // 右上角位置（留出边距）
-    Point textPos(extendedCanvas.cols - textSize.width - 30, textSize.height + 30);
-
-    // 绘制文本
-    putText(extendedCanvas, judgementText, textPos, fontFace, fontScale, judgementColor, thickness);
+    // 绘制检测结果画布 (2行3列子图 + 底部模板匹配结果 + 右上角判定)
+    Mat extendedCanvas;
+    renderDetectionCanvas(displayImages, displayTitles, matchResults, isOK, algorithmMs, totalMs, extendedCanvas);
 
     // 显示主要结果窗口
     namedWindow("HSV Detection and Processing", WINDOW_AUTOSIZE);
@@ -198,10 +985,10 @@ int main(int argc, char *argv[])
 
         // 转换为HSV用于颜色分析
         Mat hsvImage;
-        cvtColor(rgbImage, hsvImage, COLOR_BGR2HSV);
+        cvtColor(resizedImage, hsvImage, COLOR_BGR2HSV);
 
         // 显示交互式颜色分析窗口
-        showColorAnalysis(hsvImage, rgbImage);
+        showColorAnalysis(hsvImage, resizedImage);
     }
 
     return 0;
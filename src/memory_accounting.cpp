@@ -0,0 +1,460 @@
+/*
+ * 分阶段内存统计 - 计数 MatAllocator + 全局 new/delete 挂钩
+ */
+
+#include "memory_accounting.h"
+#include "config_constants.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+// 以下全局量都是常量初始化的，operator new 在 main 之前被调用也是安全的
+struct AtomicStageStats
+{
+    atomic<uint64_t> matBytes;
+    atomic<uint64_t> matCount;
+    atomic<uint64_t> heapBytes;
+    atomic<uint64_t> heapCount;
+    atomic<uint64_t> peakBytes;
+};
+
+static const int STAGE_COUNT = int(MemoryStage::Count);
+
+static atomic<bool> g_enabled{false};
+static atomic<int64_t> g_liveBytes{0};
+static AtomicStageStats g_stats[STAGE_COUNT];
+static thread_local MemoryStage t_stage = MemoryStage::Other;
+
+const char *memoryStageName(MemoryStage stage)
+{
+    switch (stage)
+    {
+    case MemoryStage::Decode:
+        return "decode";
+    case MemoryStage::Resize:
+        return "resize";
+    case MemoryStage::HsvMask:
+        return "hsv_mask";
+    case MemoryStage::Morphology:
+        return "morphology";
+    case MemoryStage::ContourFill:
+        return "contour_fill";
+    case MemoryStage::CcFilter:
+        return "cc_filter";
+    case MemoryStage::Matching:
+        return "matching";
+    default:
+        return "other";
+    }
+}
+
+// 用当前驻留量更新阶段峰值
+static void updatePeak(atomic<uint64_t> &peak, int64_t live)
+{
+    if (live <= 0)
+    {
+        return;
+    }
+
+    uint64_t value = uint64_t(live);
+    uint64_t current = peak.load(memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, memory_order_relaxed))
+    {
+    }
+}
+
+static void recordAllocation(bool isMat, size_t bytes)
+{
+    AtomicStageStats &stats = g_stats[int(t_stage)];
+    if (isMat)
+    {
+        stats.matBytes.fetch_add(bytes, memory_order_relaxed);
+        stats.matCount.fetch_add(1, memory_order_relaxed);
+    }
+    else
+    {
+        stats.heapBytes.fetch_add(bytes, memory_order_relaxed);
+        stats.heapCount.fetch_add(1, memory_order_relaxed);
+    }
+
+    int64_t live = g_liveBytes.fetch_add(int64_t(bytes), memory_order_relaxed) + int64_t(bytes);
+    updatePeak(stats.peakBytes, live);
+}
+
+static void recordFree(size_t bytes)
+{
+    g_liveBytes.fetch_sub(int64_t(bytes), memory_order_relaxed);
+}
+
+// ==================== 计数 MatAllocator ====================
+
+// 包装 OpenCV 默认分配器：分配后把 UMatData 的当前分配器改成自己，释放时才能回到这里
+class CountingMatAllocator : public MatAllocator
+{
+public:
+    UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                       AccessFlag flags, UMatUsageFlags usageFlags) const override
+    {
+        UMatData *u = Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u != nullptr)
+        {
+            u->currAllocator = this;
+            recordAllocation(true, u->size);
+        }
+        return u;
+    }
+
+    bool allocate(UMatData *data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override
+    {
+        return Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(UMatData *data) const override
+    {
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        // 关闭统计后分配的 Mat 不会走到这里，这里的都是本分配器分配的
+        recordFree(data->size);
+        data->currAllocator = Mat::getStdAllocator();
+        Mat::getStdAllocator()->deallocate(data);
+    }
+};
+
+// 分配器对象永不销毁：关闭统计后仍可能有 Mat 持有指向它的 UMatData
+static CountingMatAllocator *countingAllocator()
+{
+    static CountingMatAllocator *allocator = new CountingMatAllocator();
+    return allocator;
+}
+
+void enableMemoryAccounting()
+{
+    for (AtomicStageStats &stats : g_stats)
+    {
+        stats.matBytes = 0;
+        stats.matCount = 0;
+        stats.heapBytes = 0;
+        stats.heapCount = 0;
+        stats.peakBytes = 0;
+    }
+    g_liveBytes = 0;
+
+    Mat::setDefaultAllocator(countingAllocator());
+    g_enabled = true;
+
+    if (!memoryHooksCompiledIn())
+    {
+        cout << "提示: 未启用 TABLEWARE_MEMORY_HOOKS 编译选项，只统计 Mat 像素内存" << endl;
+    }
+}
+
+void disableMemoryAccounting()
+{
+    g_enabled = false;
+    Mat::setDefaultAllocator(nullptr);
+}
+
+bool memoryHooksCompiledIn()
+{
+#ifdef TABLEWARE_MEMORY_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+vector<MemoryStageStats> memoryStageSnapshot()
+{
+    vector<MemoryStageStats> snapshot(STAGE_COUNT);
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        snapshot[i].matBytes = g_stats[i].matBytes.load();
+        snapshot[i].matCount = g_stats[i].matCount.load();
+        snapshot[i].heapBytes = g_stats[i].heapBytes.load();
+        snapshot[i].heapCount = g_stats[i].heapCount.load();
+        snapshot[i].peakBytes = g_stats[i].peakBytes.load();
+    }
+    return snapshot;
+}
+
+MemoryStageScope::MemoryStageScope(MemoryStage stage)
+    : m_previous(t_stage)
+{
+    t_stage = stage;
+
+    // 阶段开始时的驻留量也计入峰值（阶段本身可能不分配内存）
+    if (g_enabled.load(memory_order_relaxed))
+    {
+        updatePeak(g_stats[int(stage)].peakBytes, g_liveBytes.load(memory_order_relaxed));
+    }
+}
+
+MemoryStageScope::~MemoryStageScope()
+{
+    t_stage = m_previous;
+}
+
+// ==================== 报告与基线比较 ====================
+
+// 每帧指标：总分配字节、总分配次数、峰值
+struct StageMetrics
+{
+    double bytesPerFrame = 0.0;
+    double countPerFrame = 0.0;
+    double peakBytes = 0.0;
+};
+
+static bool loadBaseline(const string &path, map<string, StageMetrics> &baseline)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        istringstream iss(line);
+        string name;
+        StageMetrics metrics;
+        if (iss >> name >> metrics.bytesPerFrame >> metrics.countPerFrame >> metrics.peakBytes)
+        {
+            baseline[name] = metrics;
+        }
+    }
+    return true;
+}
+
+static bool saveBaseline(const string &path, const vector<StageMetrics> &metrics)
+{
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "错误: 无法写入内存基线文件 " << path << endl;
+        return false;
+    }
+
+    file << "# stage bytes_per_frame allocs_per_frame peak_bytes" << endl;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        file << memoryStageName(MemoryStage(i)) << " " << fixed << setprecision(1)
+             << metrics[i].bytesPerFrame << " " << metrics[i].countPerFrame << " " << metrics[i].peakBytes << endl;
+    }
+    return true;
+}
+
+// 当前值超过基线 (1 + tolerance) 倍且绝对增长超过 slack 时视为回归
+static bool isRegression(double current, double baseline, double tolerance, double slack)
+{
+    return current > baseline * (1.0 + tolerance) && current - baseline > slack;
+}
+
+bool reportMemoryStages(const vector<MemoryStageStats> &stats, int frames,
+                        const string &baselineFile, double tolerance)
+{
+    int frameCount = max(frames, 1);
+    vector<StageMetrics> metrics(STAGE_COUNT);
+    for (int i = 0; i < STAGE_COUNT && i < int(stats.size()); i++)
+    {
+        metrics[i].bytesPerFrame = double(stats[i].matBytes + stats[i].heapBytes) / frameCount;
+        metrics[i].countPerFrame = double(stats[i].matCount + stats[i].heapCount) / frameCount;
+        metrics[i].peakBytes = double(stats[i].peakBytes);
+    }
+
+    map<string, StageMetrics> baseline;
+    bool hasBaseline = !baselineFile.empty() && loadBaseline(baselineFile, baseline);
+    bool regressed = false;
+
+    cout << "========== 分阶段内存统计（每帧平均，" << frames << " 帧） ==========" << endl;
+    cout << left << setw(14) << "stage" << right
+         << setw(12) << "Mat KB" << setw(10) << "Mat次数"
+         << setw(12) << "堆 KB" << setw(10) << "堆次数"
+         << setw(12) << "峰值 KB" << "  " << (hasBaseline ? "基线比较" : "") << endl;
+
+    for (int i = 0; i < STAGE_COUNT && i < int(stats.size()); i++)
+    {
+        string name = memoryStageName(MemoryStage(i));
+        cout << left << setw(14) << name << right << fixed << setprecision(1)
+             << setw(12) << stats[i].matBytes / 1024.0 / frameCount
+             << setw(10) << double(stats[i].matCount) / frameCount
+             << setw(12) << stats[i].heapBytes / 1024.0 / frameCount
+             << setw(10) << double(stats[i].heapCount) / frameCount
+             << setw(12) << stats[i].peakBytes / 1024.0;
+
+        auto it = baseline.find(name);
+        if (hasBaseline && it != baseline.end())
+        {
+            const StageMetrics &base = it->second;
+            string flags;
+            if (isRegression(metrics[i].bytesPerFrame, base.bytesPerFrame, tolerance,
+                             MemoryAccountingConfig::REGRESSION_MIN_BYTES))
+            {
+                flags += " bytes";
+            }
+            if (isRegression(metrics[i].countPerFrame, base.countPerFrame, tolerance, 1.0))
+            {
+                flags += " allocs";
+            }
+            if (isRegression(metrics[i].peakBytes, base.peakBytes, tolerance,
+                             MemoryAccountingConfig::REGRESSION_MIN_BYTES))
+            {
+                flags += " peak";
+            }
+
+            if (!flags.empty())
+            {
+                regressed = true;
+                cout << "  REGRESSION:" << flags;
+            }
+            else
+            {
+                cout << "  ok";
+            }
+        }
+        cout << endl;
+    }
+
+    if (!baselineFile.empty() && !hasBaseline)
+    {
+        if (saveBaseline(baselineFile, metrics))
+        {
+            cout << "未找到内存基线，已将本次结果写入 " << baselineFile << endl;
+        }
+    }
+    else if (hasBaseline)
+    {
+        cout << (regressed ? "内存回归: 有阶段超过基线 " : "内存统计: 所有阶段均在基线 ")
+             << int(tolerance * 100) << "%" << (regressed ? "" : " 以内") << endl;
+    }
+    cout << "============================================================" << endl;
+
+    return !regressed;
+}
+
+// ==================== 全局 new/delete 挂钩 ====================
+
+#ifdef TABLEWARE_MEMORY_HOOKS
+
+// 分配块的实际大小（分配与释放使用同一度量，无需额外记录头）
+static size_t allocationSize(void *ptr)
+{
+#if defined(_WIN32)
+    return _msize(ptr);
+#elif defined(__APPLE__)
+    return malloc_size(ptr);
+#else
+    return malloc_usable_size(ptr);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    void *ptr;
+    while ((ptr = malloc(size)) == nullptr)
+    {
+        new_handler handler = get_new_handler();
+        if (handler == nullptr)
+        {
+            throw bad_alloc();
+        }
+        handler();
+    }
+
+    if (g_enabled.load(memory_order_relaxed))
+    {
+        recordAllocation(false, allocationSize(ptr));
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    try
+    {
+        return ::operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    return ::operator new(size, nothrow);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    // 开启统计之前分配的块在这里被释放时驻留量会偏低，峰值是相对开启时刻的值
+    if (g_enabled.load(memory_order_relaxed))
+    {
+        recordFree(allocationSize(ptr));
+    }
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    ::operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    ::operator delete(ptr);
+}
+
+void operator delete(void *ptr, const nothrow_t &) noexcept
+{
+    ::operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const nothrow_t &) noexcept
+{
+    ::operator delete(ptr);
+}
+
+#endif // TABLEWARE_MEMORY_HOOKS
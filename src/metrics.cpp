@@ -0,0 +1,581 @@
+/*
+ * 运行指标导出 - 按线程分片的无锁计数/直方图 + Prometheus 文本文件
+ */
+
+#include "metrics.h"
+#include "config_constants.h"
+#include "latency_histogram.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const size_t SCORE_BUCKET_COUNT = sizeof(MetricsConfig::SCORE_BUCKETS) / sizeof(double);
+static const double QUANTILES[] = {0.5, 0.99, 0.999};
+
+// 分片内的每个原子量只有所属线程写入，读-改-写不需要 lock 前缀
+static inline void bump(atomic<uint64_t> &counter, uint64_t delta = 1)
+{
+    counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+// 所有延迟直方图共用的分桶布局（微秒）
+static const LatencyHistogram &histogramLayout()
+{
+    static const LatencyHistogram layout;
+    return layout;
+}
+
+// 单写者延迟直方图，分桶与 LatencyHistogram 相同（总数不单独计数，导出时由桶求和，与各桶一致）
+struct AtomicLatencyHistogram
+{
+    unique_ptr<atomic<uint64_t>[]> buckets;
+    atomic<uint64_t> sumUs{0};
+
+    AtomicLatencyHistogram() : buckets(new atomic<uint64_t>[histogramLayout().bucketCount()]())
+    {
+    }
+
+    void record(double ms)
+    {
+        uint64_t us = uint64_t(max(ms, 0.0) * 1000.0 + 0.5);
+        bump(buckets[histogramLayout().bucketIndex(us)]);
+        bump(sumUs, us);
+    }
+};
+
+struct TemplateSeries
+{
+    AtomicLatencyHistogram latency;
+    atomic<uint64_t> scoreBuckets[SCORE_BUCKET_COUNT + 1] = {}; // 最后一个为超出所有边界（+Inf）
+    atomic<double> scoreSum{0.0};
+    atomic<uint64_t> passed{0};
+    atomic<uint64_t> failed{0};
+};
+
+// 一个线程的全部指标；阶段和模板序列在首次出现时分配，以 release 发布给导出线程
+struct MetricsShard
+{
+    atomic<uint64_t> frames{0};
+    atomic<uint64_t> ok{0};
+    atomic<uint64_t> ng{0};
+    atomic<uint64_t> degraded{0};
+    AtomicLatencyHistogram frameLatency;
+    atomic<AtomicLatencyHistogram *> stages[MetricsConfig::MAX_STAGE_SERIES] = {};
+    atomic<TemplateSeries *> templates[MetricsConfig::MAX_TEMPLATE_SERIES] = {};
+
+    ~MetricsShard()
+    {
+        for (auto &stage : stages)
+        {
+            delete stage.load();
+        }
+        for (auto &series : templates)
+        {
+            delete series.load();
+        }
+    }
+};
+
+// 序列名称表：只在新名称首次出现时加锁，各线程把 名称->编号 缓存在线程局部表里
+struct SeriesNames
+{
+    vector<string> names;
+    int capacity;
+};
+
+static mutex g_registryMutex;
+static vector<unique_ptr<MetricsShard>> g_shards; // 分片在进程结束前不释放，线程退出后计数仍然保留
+static SeriesNames g_stageNames{{}, MetricsConfig::MAX_STAGE_SERIES};
+static SeriesNames g_templateNames{{}, MetricsConfig::MAX_TEMPLATE_SERIES};
+static thread_local MetricsShard *t_shard = nullptr;
+static thread_local unordered_map<string, int> t_stageIds;
+static thread_local unordered_map<string, int> t_templateIds;
+
+// 其他模块登记的值（g_registryMutex 保护）
+struct ExternalValue
+{
+    string name;
+    string type;
+    string help;
+    function<double()> read;
+};
+
+static vector<ExternalValue> g_externalValues;
+
+static atomic<bool> g_enabled{false};
+
+struct MetricsExporter
+{
+    string path;
+    double intervalS = MetricsConfig::WRITE_INTERVAL_S;
+    thread writer;
+    mutex stopMutex;
+    condition_variable stopCondition;
+    bool stopping = false;
+};
+
+static MetricsExporter g_exporter;
+
+static MetricsShard &currentShard()
+{
+    if (t_shard == nullptr)
+    {
+        lock_guard<mutex> lock(g_registryMutex);
+        g_shards.push_back(make_unique<MetricsShard>());
+        t_shard = g_shards.back().get();
+    }
+    return *t_shard;
+}
+
+// 返回序列编号；超过上限的新名称返回 -1（不记录）
+static int seriesId(const string &name, SeriesNames &table, unordered_map<string, int> &cache)
+{
+    auto cached = cache.find(name);
+    if (cached != cache.end())
+    {
+        return cached->second;
+    }
+
+    int id = -1;
+    {
+        lock_guard<mutex> lock(g_registryMutex);
+        for (size_t i = 0; i < table.names.size(); i++)
+        {
+            if (table.names[i] == name)
+            {
+                id = int(i);
+                break;
+            }
+        }
+        if (id < 0 && int(table.names.size()) < table.capacity)
+        {
+            table.names.push_back(name);
+            id = int(table.names.size()) - 1;
+        }
+    }
+    cache[name] = id;
+    return id;
+}
+
+template <typename T>
+static T &seriesSlot(atomic<T *> &slot)
+{
+    T *series = slot.load(memory_order_relaxed);
+    if (series == nullptr)
+    {
+        series = new T();
+        slot.store(series, memory_order_release);
+    }
+    return *series;
+}
+
+void recordFrameMetrics(const DetectionPipelineResult &result, double frameMs)
+{
+    if (!g_enabled.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    MetricsShard &shard = currentShard();
+    bump(shard.frames);
+    bump(result.isOK ? shard.ok : shard.ng);
+    if (result.degraded)
+    {
+        bump(shard.degraded);
+    }
+    shard.frameLatency.record(frameMs);
+
+    for (const auto &stage : result.stageMs)
+    {
+        int id = seriesId(stage.first, g_stageNames, t_stageIds);
+        if (id >= 0)
+        {
+            seriesSlot(shard.stages[id]).record(stage.second);
+        }
+    }
+
+    for (const auto &match : result.matchResults)
+    {
+        int id = seriesId(match.filename, g_templateNames, t_templateIds);
+        if (id < 0)
+        {
+            continue;
+        }
+
+        TemplateSeries &series = seriesSlot(shard.templates[id]);
+        series.latency.record(match.matchMs);
+        size_t bucket = 0;
+        while (bucket < SCORE_BUCKET_COUNT && match.score > MetricsConfig::SCORE_BUCKETS[bucket])
+        {
+            bucket++;
+        }
+        bump(series.scoreBuckets[bucket]);
+        series.scoreSum.store(series.scoreSum.load(memory_order_relaxed) + match.score, memory_order_relaxed);
+        bump(match.passed ? series.passed : series.failed);
+    }
+}
+
+// ==================== 汇总与写出 ====================
+
+struct LatencySnapshot
+{
+    vector<uint64_t> buckets;
+    uint64_t count = 0; // 各桶之和
+    uint64_t sumUs = 0;
+};
+
+static void accumulate(LatencySnapshot &snapshot, const AtomicLatencyHistogram &histogram)
+{
+    if (snapshot.buckets.empty())
+    {
+        snapshot.buckets.assign(histogramLayout().bucketCount(), 0);
+    }
+    // 记录线程可能正在写入：总数取读到的各桶之和，+Inf 和 _count 才不会小于最后一个 le 的累计数
+    for (size_t i = 0; i < snapshot.buckets.size(); i++)
+    {
+        uint64_t value = histogram.buckets[i].load(memory_order_relaxed);
+        snapshot.buckets[i] += value;
+        snapshot.count += value;
+    }
+    snapshot.sumUs += histogram.sumUs.load(memory_order_relaxed);
+}
+
+static string escapeLabel(const string &value)
+{
+    string escaped;
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// labels 为空或形如 key="value"，用于拼接到 le / quantile 前面
+static string joinLabels(const string &labels, const string &extra)
+{
+    if (labels.empty())
+    {
+        return "{" + extra + "}";
+    }
+    return "{" + labels + "," + extra + "}";
+}
+
+static void writeHeader(ostream &out, const string &name, const string &type, const string &help)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+// 每个 le 边界的累计数取上界不超过该边界的桶（桶宽不超过相对精度，误差可忽略）
+static void writeLatencySeries(ostream &out, const string &name, const string &labels, const LatencySnapshot &snapshot)
+{
+    const LatencyHistogram &layout = histogramLayout();
+    uint64_t cumulative = 0;
+    size_t bucket = 0;
+    for (double boundMs : MetricsConfig::LATENCY_BUCKETS_MS)
+    {
+        uint64_t boundUs = uint64_t(boundMs * 1000.0);
+        while (bucket < snapshot.buckets.size() && layout.bucketUpperBound(bucket) <= boundUs)
+        {
+            cumulative += snapshot.buckets[bucket++];
+        }
+        ostringstream le;
+        le << "le=\"" << boundMs / 1000.0 << "\"";
+        out << name << "_bucket" << joinLabels(labels, le.str()) << " " << cumulative << "\n";
+    }
+    out << name << "_bucket" << joinLabels(labels, "le=\"+Inf\"") << " " << snapshot.count << "\n";
+    out << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << snapshot.sumUs / 1e6 << "\n";
+    out << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << snapshot.count << "\n";
+}
+
+static void writeQuantiles(ostream &out, const string &name, const string &labels, const LatencySnapshot &snapshot)
+{
+    const LatencyHistogram &layout = histogramLayout();
+    for (double quantile : QUANTILES)
+    {
+        double valueS = 0.0;
+        if (snapshot.count > 0)
+        {
+            uint64_t target = max<uint64_t>(uint64_t(ceil(quantile * snapshot.count)), 1);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < snapshot.buckets.size(); i++)
+            {
+                seen += snapshot.buckets[i];
+                if (seen >= target)
+                {
+                    valueS = layout.bucketUpperBound(i) / 1e6;
+                    break;
+                }
+            }
+        }
+        ostringstream q;
+        q << "quantile=\"" << quantile << "\"";
+        out << name << joinLabels(labels, q.str()) << " " << valueS << "\n";
+    }
+}
+
+static bool writeMetricsFile(const string &path)
+{
+    uint64_t frames = 0, ok = 0, ng = 0, degraded = 0;
+    LatencySnapshot frameLatency;
+    vector<string> stageNames, templateNames;
+    vector<LatencySnapshot> stageLatency(MetricsConfig::MAX_STAGE_SERIES);
+    vector<LatencySnapshot> templateLatency(MetricsConfig::MAX_TEMPLATE_SERIES);
+    vector<vector<uint64_t>> scoreBuckets(MetricsConfig::MAX_TEMPLATE_SERIES, vector<uint64_t>(SCORE_BUCKET_COUNT + 1, 0));
+    vector<double> scoreSum(MetricsConfig::MAX_TEMPLATE_SERIES, 0.0);
+    vector<uint64_t> passed(MetricsConfig::MAX_TEMPLATE_SERIES, 0), failed(MetricsConfig::MAX_TEMPLATE_SERIES, 0);
+    vector<pair<const ExternalValue *, double>> externalValues;
+
+    {
+        // 只阻塞新线程注册和新序列名称，记录路径不受影响
+        lock_guard<mutex> lock(g_registryMutex);
+        stageNames = g_stageNames.names;
+        templateNames = g_templateNames.names;
+        for (const ExternalValue &value : g_externalValues)
+        {
+            externalValues.emplace_back(&value, value.read());
+        }
+        for (const auto &shard : g_shards)
+        {
+            frames += shard->frames.load(memory_order_relaxed);
+            ok += shard->ok.load(memory_order_relaxed);
+            ng += shard->ng.load(memory_order_relaxed);
+            degraded += shard->degraded.load(memory_order_relaxed);
+            accumulate(frameLatency, shard->frameLatency);
+
+            for (int i = 0; i < MetricsConfig::MAX_STAGE_SERIES; i++)
+            {
+                const AtomicLatencyHistogram *stage = shard->stages[i].load(memory_order_acquire);
+                if (stage != nullptr)
+                {
+                    accumulate(stageLatency[i], *stage);
+                }
+            }
+            for (int i = 0; i < MetricsConfig::MAX_TEMPLATE_SERIES; i++)
+            {
+                const TemplateSeries *series = shard->templates[i].load(memory_order_acquire);
+                if (series == nullptr)
+                {
+                    continue;
+                }
+                accumulate(templateLatency[i], series->latency);
+                for (size_t b = 0; b <= SCORE_BUCKET_COUNT; b++)
+                {
+                    scoreBuckets[i][b] += series->scoreBuckets[b].load(memory_order_relaxed);
+                }
+                scoreSum[i] += series->scoreSum.load(memory_order_relaxed);
+                passed[i] += series->passed.load(memory_order_relaxed);
+                failed[i] += series->failed.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    ostringstream out;
+    writeHeader(out, "tableware_frames_total", "counter", "Frames processed by the detection pipeline.");
+    out << "tableware_frames_total " << frames << "\n";
+    writeHeader(out, "tableware_verdicts_total", "counter", "Frame verdicts.");
+    out << "tableware_verdicts_total{verdict=\"ok\"} " << ok << "\n";
+    out << "tableware_verdicts_total{verdict=\"ng\"} " << ng << "\n";
+    writeHeader(out, "tableware_degraded_frames_total", "counter", "Frames processed with a degraded pipeline to meet the latency budget.");
+    out << "tableware_degraded_frames_total " << degraded << "\n";
+
+    writeHeader(out, "tableware_frame_latency_seconds", "histogram", "Per-frame pipeline latency.");
+    if (frameLatency.buckets.empty())
+    {
+        frameLatency.buckets.assign(histogramLayout().bucketCount(), 0);
+    }
+    writeLatencySeries(out, "tableware_frame_latency_seconds", "", frameLatency);
+    writeHeader(out, "tableware_frame_latency_quantile_seconds", "gauge", "Per-frame latency quantiles since start.");
+    writeQuantiles(out, "tableware_frame_latency_quantile_seconds", "", frameLatency);
+
+    if (!stageNames.empty())
+    {
+        writeHeader(out, "tableware_stage_latency_seconds", "histogram", "Latency of each pipeline stage.");
+        for (size_t i = 0; i < stageNames.size(); i++)
+        {
+            if (stageLatency[i].count > 0)
+            {
+                writeLatencySeries(out, "tableware_stage_latency_seconds", "stage=\"" + escapeLabel(stageNames[i]) + "\"", stageLatency[i]);
+            }
+        }
+        writeHeader(out, "tableware_stage_latency_quantile_seconds", "gauge", "Pipeline stage latency quantiles since start.");
+        for (size_t i = 0; i < stageNames.size(); i++)
+        {
+            if (stageLatency[i].count > 0)
+            {
+                writeQuantiles(out, "tableware_stage_latency_quantile_seconds", "stage=\"" + escapeLabel(stageNames[i]) + "\"", stageLatency[i]);
+            }
+        }
+    }
+
+    if (!templateNames.empty())
+    {
+        writeHeader(out, "tableware_template_match_latency_seconds", "histogram", "Matching latency of each template.");
+        for (size_t i = 0; i < templateNames.size(); i++)
+        {
+            if (templateLatency[i].count > 0)
+            {
+                writeLatencySeries(out, "tableware_template_match_latency_seconds", "template=\"" + escapeLabel(templateNames[i]) + "\"", templateLatency[i]);
+            }
+        }
+
+        writeHeader(out, "tableware_template_score", "histogram",
+                    "Similarity score of each template; a pass found by early stop reports the first position "
+                    "that reached the threshold, a lower bound of the best score.");
+        for (size_t i = 0; i < templateNames.size(); i++)
+        {
+            string labels = "template=\"" + escapeLabel(templateNames[i]) + "\"";
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < SCORE_BUCKET_COUNT; b++)
+            {
+                cumulative += scoreBuckets[i][b];
+                ostringstream le;
+                le << "le=\"" << MetricsConfig::SCORE_BUCKETS[b] << "\"";
+                out << "tableware_template_score_bucket" << joinLabels(labels, le.str()) << " " << cumulative << "\n";
+            }
+            cumulative += scoreBuckets[i][SCORE_BUCKET_COUNT];
+            out << "tableware_template_score_bucket" << joinLabels(labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+            out << "tableware_template_score_sum{" << labels << "} " << scoreSum[i] << "\n";
+            out << "tableware_template_score_count{" << labels << "} " << cumulative << "\n";
+        }
+
+        writeHeader(out, "tableware_template_verdicts_total", "counter", "Per-template pass/fail results.");
+        for (size_t i = 0; i < templateNames.size(); i++)
+        {
+            string labels = "template=\"" + escapeLabel(templateNames[i]) + "\"";
+            out << "tableware_template_verdicts_total{" << labels << ",result=\"pass\"} " << passed[i] << "\n";
+            out << "tableware_template_verdicts_total{" << labels << ",result=\"fail\"} " << failed[i] << "\n";
+        }
+    }
+
+    for (const auto &value : externalValues)
+    {
+        writeHeader(out, value.first->name, value.first->type, value.first->help);
+        out << value.first->name << " " << value.second << "\n";
+    }
+
+    // 先写临时文件再改名：采集方读到的总是完整的一份
+    string tempPath = path + ".tmp";
+    {
+        ofstream file(tempPath, ios::trunc);
+        if (!file.is_open())
+        {
+            cerr << "错误: 无法写入指标文件 " << tempPath << endl;
+            return false;
+        }
+        file << out.str();
+        if (!file)
+        {
+            cerr << "错误: 写入指标文件失败: " << tempPath << endl;
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec)
+    {
+        cerr << "错误: 无法写入指标文件 " << path << ": " << ec.message() << endl;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+static void metricsWriterLoop()
+{
+    unique_lock<mutex> lock(g_exporter.stopMutex);
+    auto interval = chrono::duration<double>(g_exporter.intervalS);
+    while (!g_exporter.stopping)
+    {
+        g_exporter.stopCondition.wait_for(lock, interval, [] { return g_exporter.stopping; });
+        lock.unlock();
+        writeMetricsFile(g_exporter.path);
+        lock.lock();
+    }
+}
+
+bool startMetricsExport(const string &path, double intervalS)
+{
+    if (g_enabled.load())
+    {
+        cerr << "错误: 指标导出已启动" << endl;
+        return false;
+    }
+    if (path.empty() || intervalS <= 0.0)
+    {
+        cerr << "错误: 指标文件路径不能为空且写入间隔必须大于0" << endl;
+        return false;
+    }
+
+    g_exporter.path = path;
+    g_exporter.intervalS = intervalS;
+    g_exporter.stopping = false;
+    g_enabled.store(true);
+    if (!writeMetricsFile(path)) // 立即写一份空指标，尽早发现路径不可写
+    {
+        g_enabled.store(false);
+        return false;
+    }
+
+    g_exporter.writer = thread(metricsWriterLoop);
+    cout << "指标导出: " << path << "（每 " << intervalS << " 秒写入一次）" << endl;
+    return true;
+}
+
+void stopMetricsExport()
+{
+    if (!g_enabled.load())
+    {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(g_exporter.stopMutex);
+        g_exporter.stopping = true;
+    }
+    g_exporter.stopCondition.notify_all();
+    if (g_exporter.writer.joinable())
+    {
+        g_exporter.writer.join(); // 退出前会写入最终值
+    }
+    g_enabled.store(false);
+
+    lock_guard<mutex> lock(g_registryMutex);
+    g_externalValues.clear();
+}
+
+void registerMetricsValue(const string &name, const string &type, const string &help, function<double()> read)
+{
+    lock_guard<mutex> lock(g_registryMutex);
+    g_externalValues.push_back({name, type, help, move(read)});
+}
+
+bool metricsEnabled()
+{
+    return g_enabled.load(memory_order_relaxed);
+}
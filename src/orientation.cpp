@@ -0,0 +1,79 @@
+/*
+ * 方向估计模块 - 基于图像矩的连通域主轴方向估计
+ */
+
+#include "orientation.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+static const double RAD_TO_DEG = 180.0 / CV_PI;
+
+BlobOrientation orientationFromMoments(const Moments &m)
+{
+    BlobOrientation orientation;
+    if (m.m00 <= 0)
+    {
+        return orientation;
+    }
+
+    // 归一化的二阶中心矩（协方差矩阵）
+    double mu20 = m.mu20 / m.m00;
+    double mu02 = m.mu02 / m.m00;
+    double mu11 = m.mu11 / m.m00;
+
+    // 协方差矩阵特征值：λ1 >= λ2
+    double delta = sqrt(4.0 * mu11 * mu11 + (mu20 - mu02) * (mu20 - mu02));
+    double lambda1 = (mu20 + mu02 + delta) / 2.0;
+    double lambda2 = (mu20 + mu02 - delta) / 2.0;
+
+    orientation.area = int(m.m00 + 0.5);
+    orientation.axisAngle = 0.5 * atan2(2.0 * mu11, mu20 - mu02) * RAD_TO_DEG;
+    orientation.elongation = sqrt(lambda1 / max(lambda2, 1e-9));
+    orientation.majorLength = 4.0 * sqrt(max(lambda1, 0.0));
+    return orientation;
+}
+
+vector<BlobOrientation> estimateBlobOrientations(const Mat &binaryMask)
+{
+    vector<BlobOrientation> orientations;
+    if (binaryMask.empty())
+    {
+        return orientations;
+    }
+
+    Mat labels, stats, centroids;
+    int numComponents = connectedComponentsWithStats(binaryMask, labels, stats, centroids);
+
+    for (int i = 1; i < numComponents; i++) // 跳过背景 (标签0)
+    {
+        Rect bbox(stats.at<int>(i, CC_STAT_LEFT), stats.at<int>(i, CC_STAT_TOP),
+                  stats.at<int>(i, CC_STAT_WIDTH), stats.at<int>(i, CC_STAT_HEIGHT));
+
+        // 只在外接矩形内计算该连通域的矩
+        Mat componentMask = (labels(bbox) == i);
+        BlobOrientation orientation = orientationFromMoments(moments(componentMask, true));
+        orientation.bbox = bbox;
+        orientations.push_back(orientation);
+    }
+
+    return orientations;
+}
+
+double predictRotationAngle(double blobAxisAngle, double templateAxisAngle)
+{
+    double angle = templateAxisAngle - blobAxisAngle;
+
+    // 主轴没有方向性，差值按 180° 周期归一化
+    while (angle > 90.0)
+    {
+        angle -= 180.0;
+    }
+    while (angle <= -90.0)
+    {
+        angle += 180.0;
+    }
+    return angle;
+}
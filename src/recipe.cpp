@@ -0,0 +1,263 @@
+/*
+ * 产品配方 - 配方文件解析、模板库预加载与活动配方切换
+ */
+
+#include "recipe.h"
+#include "config_constants.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+const vector<HsvRange> &defaultHsvRanges()
+{
+    static const vector<HsvRange> ranges = []
+    {
+        vector<HsvRange> result;
+        for (int i = 0; i < Config::RANGE_COUNT; ++i)
+        {
+            const int *range = Config::HSV_RANGES[i];
+            result.push_back({range[0], range[1], range[2], range[3], range[4], range[5]});
+        }
+        return result;
+    }();
+    return ranges;
+}
+
+static string trimRecipeText(const string &text)
+{
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == string::npos)
+    {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// 由 config_constants.h 构成的配方
+static Recipe defaultRecipe(const string &name)
+{
+    Recipe recipe;
+    recipe.name = name;
+    recipe.templateFolder = TemplateMatchConfig::TEMPLATE_FOLDER;
+    recipe.templateBankFile = TemplateMatchConfig::TEMPLATE_BANK_FILE;
+    recipe.thresholds = TemplateMatchConfig::THRESHOLDS;
+    recipe.hsvRanges = defaultHsvRanges();
+    return recipe;
+}
+
+// 解析配方文件中的一行 "键 = 值"
+static bool parseRecipeLine(const string &line, int lineNumber, Recipe &recipe, bool &hsvSpecified)
+{
+    size_t equalPos = line.find('=');
+    if (equalPos == string::npos)
+    {
+        cerr << "错误: 配方文件第 " << lineNumber << " 行格式应为 \"键 = 值\": " << line << endl;
+        return false;
+    }
+
+    string key = trimRecipeText(line.substr(0, equalPos));
+    string value = trimRecipeText(line.substr(equalPos + 1));
+
+    if (key == "template_folder")
+    {
+        recipe.templateFolder = value;
+        recipe.templateBankFile.clear(); // 换了模板文件夹，默认的预编译模板库不再适用
+    }
+    else if (key == "template_bank")
+    {
+        recipe.templateBankFile = value;
+    }
+    else if (key == "thresholds")
+    {
+        recipe.thresholds.clear();
+        stringstream ss(value);
+        string item;
+        while (getline(ss, item, ','))
+        {
+            // 阈值是相似度（0~1），拼写错误不能被当成 0 静默接受
+            item = trimRecipeText(item);
+            char *end = nullptr;
+            double threshold = strtod(item.c_str(), &end);
+            if (item.empty() || *end != '\0' || !(threshold >= 0.0 && threshold <= 1.0))
+            {
+                cerr << "错误: 配方文件第 " << lineNumber << " 行阈值应为 0~1 之间的数: \"" << item << "\"" << endl;
+                return false;
+            }
+            recipe.thresholds.push_back(threshold);
+        }
+    }
+    else if (key == "hsv")
+    {
+        HsvRange range;
+        stringstream ss(value);
+        if (!(ss >> range.hueMin >> range.hueMax >> range.satMin >> range.satMax >> range.valMin >> range.valMax))
+        {
+            cerr << "错误: 配方文件第 " << lineNumber << " 行 hsv 需要6个整数: " << value << endl;
+            return false;
+        }
+        if (!hsvSpecified)
+        {
+            recipe.hsvRanges.clear(); // 第一次出现时替换默认范围
+            hsvSpecified = true;
+        }
+        recipe.hsvRanges.push_back(range);
+    }
+    else
+    {
+        cerr << "错误: 配方文件第 " << lineNumber << " 行未知的键 \"" << key << "\"" << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool parseRecipeFile(const string &path, vector<Recipe> &recipes)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "错误: 无法打开配方文件 " << path << endl;
+        return false;
+    }
+
+    string line;
+    int lineNumber = 0;
+    bool hsvSpecified = false;
+    while (getline(file, line))
+    {
+        lineNumber++;
+        size_t commentPos = line.find('#');
+        if (commentPos != string::npos)
+        {
+            line = line.substr(0, commentPos);
+        }
+        line = trimRecipeText(line);
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            recipes.push_back(defaultRecipe(trimRecipeText(line.substr(1, line.size() - 2))));
+            hsvSpecified = false;
+            continue;
+        }
+
+        if (recipes.empty())
+        {
+            cerr << "错误: 配方文件第 " << lineNumber << " 行不在任何 [配方名] 段内" << endl;
+            return false;
+        }
+        if (!parseRecipeLine(line, lineNumber, recipes.back(), hsvSpecified))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readRecipeDefinitions(const string &path, vector<Recipe> &recipes)
+{
+    recipes.clear();
+
+    ifstream probe(path);
+    if (!probe.is_open())
+    {
+        recipes.push_back(defaultRecipe(RecipeConfig::DEFAULT_RECIPE_NAME));
+        return true;
+    }
+    probe.close();
+
+    if (!parseRecipeFile(path, recipes))
+    {
+        return false;
+    }
+    if (recipes.empty())
+    {
+        cerr << "错误: 配方文件中没有配方: " << path << endl;
+        return false;
+    }
+    cout << "使用配方文件: " << path << endl;
+    return true;
+}
+
+bool RecipeSet::load(const string &path)
+{
+    m_recipes.clear();
+    m_index.clear();
+    m_active.store(0, memory_order_release);
+
+    vector<Recipe> recipes;
+    if (!readRecipeDefinitions(path, recipes))
+    {
+        return false;
+    }
+
+    // 启动时准备好所有配方的模板库，换产时不再有加载停顿
+    for (Recipe &recipe : recipes)
+    {
+        if (recipe.name.empty() || m_index.count(recipe.name) != 0)
+        {
+            cerr << "错误: 配方名为空或重复: \"" << recipe.name << "\"" << endl;
+            return false;
+        }
+        if (recipe.hsvRanges.empty())
+        {
+            cerr << "错误: 配方 " << recipe.name << " 没有 HSV 范围" << endl;
+            return false;
+        }
+
+        cout << "准备配方 " << recipe.name << " ..." << endl;
+        if (!prepareTemplateBank(recipe.templateBankFile, recipe.templateFolder, recipe.thresholds, recipe.bank))
+        {
+            cerr << "错误: 配方 " << recipe.name << " 的模板库准备失败" << endl;
+            return false;
+        }
+
+        // 预编译模板库中的阈值是编译时的配置，以配方为准
+        if (recipe.thresholds.size() != recipe.bank.templates.size())
+        {
+            cerr << "错误: 配方 " << recipe.name << " 的模板数量(" << recipe.bank.templates.size()
+                 << ") != 阈值数量(" << recipe.thresholds.size() << ")" << endl;
+            return false;
+        }
+        for (size_t i = 0; i < recipe.bank.templates.size(); i++)
+        {
+            recipe.bank.templates[i].threshold = recipe.thresholds[i];
+        }
+
+        m_index[recipe.name] = m_recipes.size();
+        m_recipes.push_back(move(recipe));
+    }
+
+    cout << "已准备 " << m_recipes.size() << " 个配方，当前配方: " << m_recipes.front().name << endl;
+    return true;
+}
+
+bool RecipeSet::select(const string &name)
+{
+    auto it = m_index.find(name);
+    if (it == m_index.end())
+    {
+        cerr << "错误: 未知配方 \"" << name << "\"，可用配方:";
+        for (const Recipe &recipe : m_recipes)
+        {
+            cerr << " " << recipe.name;
+        }
+        cerr << endl;
+        return false;
+    }
+
+    m_active.store(it->second, memory_order_release);
+    return true;
+}
+
+const Recipe *RecipeSet::find(const string &name) const
+{
+    auto it = m_index.find(name);
+    return (it != m_index.end()) ? &m_recipes[it->second] : nullptr;
+}
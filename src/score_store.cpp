@@ -0,0 +1,462 @@
+/*
+ * 模板匹配得分库 - 追加写入每张图的全部角度得分，按新阈值重新判定
+ */
+
+#include "score_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static const char STORE_MAGIC[4] = {'T', 'W', 'S', 'S'};
+static const uint32_t STORE_VERSION = 2;
+static const uint32_t STORE_BYTE_ORDER = 0x01020304; // 按本地字节序写入，读取时不一致即为异字节序机器生成
+static const uint32_t RECORD_MAGIC = 0x52435753; // "SWCR"
+static const size_t FILENAME_LENGTH = 128;
+
+// ==================== 文件头读写 ====================
+
+static ScoreStoreSchema schemaFromBank(const TemplateBank &bank)
+{
+    ScoreStoreSchema schema;
+    for (const TemplateEntry &entry : bank.templates)
+    {
+        schema.templates.push_back(entry.filename);
+        vector<float> angles;
+        for (const TemplateVariant &variant : entry.variants)
+        {
+            angles.push_back(float(variant.angle));
+        }
+        schema.angles.push_back(angles);
+    }
+    return schema;
+}
+
+static bool sameSchema(const ScoreStoreSchema &a, const ScoreStoreSchema &b)
+{
+    return a.templates == b.templates && a.angles == b.angles;
+}
+
+static void writeHeader(ofstream &out, const ScoreStoreSchema &schema)
+{
+    uint32_t templateCount = uint32_t(schema.templates.size());
+    out.write(STORE_MAGIC, sizeof(STORE_MAGIC));
+    out.write(reinterpret_cast<const char *>(&STORE_BYTE_ORDER), sizeof(STORE_BYTE_ORDER));
+    out.write(reinterpret_cast<const char *>(&STORE_VERSION), sizeof(STORE_VERSION));
+    out.write(reinterpret_cast<const char *>(&templateCount), sizeof(templateCount));
+
+    for (size_t i = 0; i < schema.templates.size(); i++)
+    {
+        char filename[FILENAME_LENGTH] = {0};
+        strncpy(filename, schema.templates[i].c_str(), FILENAME_LENGTH - 1);
+        uint32_t angleCount = uint32_t(schema.angles[i].size());
+
+        out.write(filename, FILENAME_LENGTH);
+        out.write(reinterpret_cast<const char *>(&angleCount), sizeof(angleCount));
+        out.write(reinterpret_cast<const char *>(schema.angles[i].data()), angleCount * sizeof(float));
+    }
+}
+
+static bool readHeader(ifstream &in, const string &path, ScoreStoreSchema &schema)
+{
+    char magic[4];
+    uint32_t byteOrder = 0;
+    uint32_t version = 0;
+    uint32_t templateCount = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&byteOrder), sizeof(byteOrder));
+    in.read(reinterpret_cast<char *>(&version), sizeof(version));
+    in.read(reinterpret_cast<char *>(&templateCount), sizeof(templateCount));
+
+    if (!in || memcmp(magic, STORE_MAGIC, sizeof(magic)) != 0)
+    {
+        cerr << "错误: 不是得分库文件: " << path << endl;
+        return false;
+    }
+    if (byteOrder != STORE_BYTE_ORDER)
+    {
+        cerr << "错误: 得分库由字节序不同的机器生成，无法读取: " << path << endl;
+        return false;
+    }
+    if (version != STORE_VERSION)
+    {
+        cerr << "错误: 得分库版本不匹配 (文件 " << version << ", 程序 " << STORE_VERSION << "): " << path << endl;
+        return false;
+    }
+
+    schema = ScoreStoreSchema();
+    for (uint32_t i = 0; i < templateCount; i++)
+    {
+        char filename[FILENAME_LENGTH];
+        uint32_t angleCount = 0;
+        in.read(filename, FILENAME_LENGTH);
+        in.read(reinterpret_cast<char *>(&angleCount), sizeof(angleCount));
+        if (!in || angleCount > 4096)
+        {
+            cerr << "错误: 得分库文件头损坏: " << path << endl;
+            return false;
+        }
+
+        vector<float> angles(angleCount);
+        in.read(reinterpret_cast<char *>(angles.data()), angleCount * sizeof(float));
+        if (!in)
+        {
+            cerr << "错误: 得分库文件头损坏: " << path << endl;
+            return false;
+        }
+
+        filename[FILENAME_LENGTH - 1] = '\0';
+        schema.templates.push_back(filename);
+        schema.angles.push_back(angles);
+    }
+    return true;
+}
+
+// ==================== 读取 ====================
+
+// 读取得分库；validEnd 输出最后一条完整记录的结束位置
+static bool readScoreStore(const string &path, ScoreStoreSchema &schema, vector<ScoreRecord> &records,
+                           uint64_t &validEnd)
+{
+    records.clear();
+    validEnd = 0;
+
+    ifstream in(path, ios::binary);
+    if (!in.is_open())
+    {
+        cerr << "错误: 无法打开得分库文件 " << path << endl;
+        return false;
+    }
+
+    if (!readHeader(in, path, schema))
+    {
+        return false;
+    }
+    validEnd = uint64_t(in.tellg());
+
+    size_t scoreCount = 0;
+    for (const vector<float> &angles : schema.angles)
+    {
+        scoreCount += angles.size();
+    }
+    vector<float> scores(scoreCount);
+
+    while (in.peek() != ifstream::traits_type::eof())
+    {
+        uint32_t magic = 0;
+        uint16_t nameLength = 0;
+        uint8_t flags = 0;
+        uint8_t reserved = 0;
+        in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        in.read(reinterpret_cast<char *>(&nameLength), sizeof(nameLength));
+        in.read(reinterpret_cast<char *>(&flags), sizeof(flags));
+        in.read(reinterpret_cast<char *>(&reserved), sizeof(reserved));
+
+        ScoreRecord record;
+        record.imageName.resize(nameLength);
+        in.read(&record.imageName[0], nameLength);
+        in.read(reinterpret_cast<char *>(scores.data()), scoreCount * sizeof(float));
+
+        if (!in || magic != RECORD_MAGIC)
+        {
+            cerr << "警告: 得分库末尾有不完整或损坏的记录，已忽略（已读取 " << records.size() << " 条）" << endl;
+            break;
+        }
+
+        record.liveOK = (flags & 1) != 0;
+        size_t offset = 0;
+        for (const vector<float> &angles : schema.angles)
+        {
+            record.angleScores.emplace_back(scores.begin() + offset, scores.begin() + offset + angles.size());
+            offset += angles.size();
+        }
+        records.push_back(move(record));
+        validEnd = uint64_t(in.tellg());
+    }
+
+    return true;
+}
+
+bool loadScoreStore(const string &path, ScoreStoreSchema &schema, vector<ScoreRecord> &records)
+{
+    uint64_t validEnd = 0;
+    return readScoreStore(path, schema, records, validEnd);
+}
+
+// ==================== 写入 ====================
+
+bool ScoreStoreWriter::open(const string &path, const TemplateBank &bank)
+{
+    close();
+    m_schema = schemaFromBank(bank);
+    m_appended = 0;
+
+    // 已有文件：检查模板和角度是否一致，并截掉上次中断留下的不完整记录
+    error_code ec;
+    bool exists = fs::exists(path, ec) && fs::file_size(path, ec) > 0;
+    if (exists)
+    {
+        ScoreStoreSchema schema;
+        vector<ScoreRecord> records;
+        uint64_t validEnd = 0;
+        if (!readScoreStore(path, schema, records, validEnd))
+        {
+            return false;
+        }
+        if (!sameSchema(schema, m_schema))
+        {
+            cerr << "错误: 得分库 " << path << " 的模板/角度与当前模板库不一致，请换一个文件" << endl;
+            return false;
+        }
+        if (validEnd < fs::file_size(path, ec))
+        {
+            fs::resize_file(path, validEnd, ec);
+            if (ec)
+            {
+                cerr << "错误: 无法截断得分库中不完整的记录: " << ec.message() << endl;
+                return false;
+            }
+        }
+    }
+
+    m_file.open(path, ios::binary | ios::app);
+    if (!m_file.is_open())
+    {
+        cerr << "错误: 无法打开得分库文件 " << path << endl;
+        return false;
+    }
+
+    if (!exists)
+    {
+        writeHeader(m_file, m_schema);
+        m_file.flush();
+    }
+    return true;
+}
+
+bool ScoreStoreWriter::append(const string &imageName, const vector<TemplateMatchResult> &results, bool liveOK)
+{
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+
+    // 整条记录先拼好再一次写入
+    uint16_t nameLength = uint16_t(min<size_t>(imageName.size(), UINT16_MAX));
+    uint8_t flags = liveOK ? 1 : 0;
+    uint8_t reserved = 0;
+
+    string record;
+    record.append(reinterpret_cast<const char *>(&RECORD_MAGIC), sizeof(RECORD_MAGIC));
+    record.append(reinterpret_cast<const char *>(&nameLength), sizeof(nameLength));
+    record.append(reinterpret_cast<const char *>(&flags), sizeof(flags));
+    record.append(reinterpret_cast<const char *>(&reserved), sizeof(reserved));
+    record.append(imageName, 0, nameLength);
+
+    for (size_t t = 0; t < m_schema.templates.size(); t++)
+    {
+        for (size_t a = 0; a < m_schema.angles[t].size(); a++)
+        {
+            float score = numeric_limits<float>::quiet_NaN();
+            if (t < results.size() && a < results[t].angleScores.size())
+            {
+                score = results[t].angleScores[a];
+            }
+            record.append(reinterpret_cast<const char *>(&score), sizeof(score));
+        }
+    }
+
+    m_file.write(record.data(), record.size());
+    m_file.flush();
+    if (!m_file)
+    {
+        cerr << "错误: 写入得分库失败" << endl;
+        return false;
+    }
+
+    m_appended++;
+    return true;
+}
+
+void ScoreStoreWriter::close()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+}
+
+// ==================== 重新判定 ====================
+
+// 标注文件：每行 "<图片名> OK|NG"（逗号或空白分隔，# 开头为注释）
+static bool loadLabels(const string &path, map<string, bool> &labels)
+{
+    ifstream in(path);
+    if (!in.is_open())
+    {
+        cerr << "错误: 无法打开标注文件 " << path << endl;
+        return false;
+    }
+
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        // 最后一个分隔符之后是标签，之前是图片名（图片名中可能有空格）
+        size_t separator = line.find_last_of(", \t");
+        if (separator == string::npos)
+        {
+            continue;
+        }
+        string name = line.substr(0, separator);
+        string label = line.substr(separator + 1);
+        while (!label.empty() && (label.back() == '\r' || label.back() == ' '))
+        {
+            label.pop_back();
+        }
+        while (!name.empty() && (name.back() == ',' || name.back() == ' ' || name.back() == '\t'))
+        {
+            name.pop_back();
+        }
+
+        if (label == "OK" || label == "ok")
+        {
+            labels[name] = true;
+        }
+        else if (label == "NG" || label == "ng")
+        {
+            labels[name] = false;
+        }
+    }
+    return true;
+}
+
+// 模板得分 = 所有测试过的角度中的最大相似度（与实时判定一致）
+static float templateScore(const vector<float> &angleScores)
+{
+    float best = 0.0f;
+    for (float score : angleScores)
+    {
+        if (!std::isnan(score) && score > best)
+        {
+            best = score;
+        }
+    }
+    return best;
+}
+
+bool rejudgeScoreStore(const string &storePath, const string &labelsPath, const vector<double> &thresholds)
+{
+    auto start = chrono::steady_clock::now();
+
+    ScoreStoreSchema schema;
+    vector<ScoreRecord> records;
+    if (!loadScoreStore(storePath, schema, records))
+    {
+        return false;
+    }
+
+    if (thresholds.empty() || (thresholds.size() != 1 && thresholds.size() != schema.templates.size()))
+    {
+        cerr << "错误: 阈值个数应为 1 或模板数 " << schema.templates.size() << endl;
+        return false;
+    }
+
+    map<string, bool> labels;
+    bool hasLabels = !labelsPath.empty();
+    if (hasLabels && !loadLabels(labelsPath, labels))
+    {
+        return false;
+    }
+
+    int okCount = 0;
+    int changedCount = 0;
+    vector<int> templatePassCount(schema.templates.size(), 0);
+
+    // 混淆矩阵：[标注][判定]，下标 0=OK, 1=NG
+    int confusion[2][2] = {{0, 0}, {0, 0}};
+    int unlabeled = 0;
+
+    for (const ScoreRecord &record : records)
+    {
+        bool isOK = true;
+        for (size_t t = 0; t < schema.templates.size(); t++)
+        {
+            double threshold = thresholds.size() == 1 ? thresholds[0] : thresholds[t];
+            bool passed = templateScore(record.angleScores[t]) >= threshold;
+            templatePassCount[t] += passed ? 1 : 0;
+            isOK = isOK && passed;
+        }
+
+        okCount += isOK ? 1 : 0;
+        changedCount += (isOK != record.liveOK) ? 1 : 0;
+
+        if (hasLabels)
+        {
+            auto it = labels.find(record.imageName);
+            if (it == labels.end())
+            {
+                unlabeled++;
+            }
+            else
+            {
+                confusion[it->second ? 0 : 1][isOK ? 0 : 1]++;
+            }
+        }
+    }
+
+    int total = int(records.size());
+    int elapsedMs = int(chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+
+    cout << "====================================" << endl;
+    cout << "重新判定: " << storePath << " (" << total << " 张, " << elapsedMs << "ms)" << endl;
+    cout << "阈值:";
+    for (size_t t = 0; t < schema.templates.size(); t++)
+    {
+        double threshold = thresholds.size() == 1 ? thresholds[0] : thresholds[t];
+        cout << " " << schema.templates[t] << "=" << fixed << setprecision(3) << threshold;
+    }
+    cout << endl;
+
+    for (size_t t = 0; t < schema.templates.size(); t++)
+    {
+        cout << "  模板 " << schema.templates[t] << ": 通过 " << templatePassCount[t] << "/" << total << endl;
+    }
+
+    cout << "OK " << okCount << ", NG " << (total - okCount)
+         << "（与记录时判定不同: " << changedCount << " 张）" << endl;
+
+    if (hasLabels)
+    {
+        int labeled = total - unlabeled;
+        int correct = confusion[0][0] + confusion[1][1];
+        cout << "混淆矩阵（行=标注，列=判定）:" << endl;
+        cout << "            判定OK   判定NG" << endl;
+        cout << "  标注OK " << setw(9) << confusion[0][0] << setw(9) << confusion[0][1] << endl;
+        cout << "  标注NG " << setw(9) << confusion[1][0] << setw(9) << confusion[1][1] << endl;
+        cout << "准确率: " << setprecision(2) << (labeled > 0 ? 100.0 * correct / labeled : 0.0) << "%"
+             << ", 漏检(NG判为OK): " << confusion[1][0]
+             << ", 误检(OK判为NG): " << confusion[0][1];
+        if (unlabeled > 0)
+        {
+            cout << ", 无标注: " << unlabeled;
+        }
+        cout << endl;
+    }
+    cout << "====================================" << endl;
+    return true;
+}
@@ -0,0 +1,255 @@
+/*
+ * 共享内存模块 - 命名共享内存与只读文件映射的跨平台封装
+ */
+
+#include "shared_memory.h"
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+// Windows 命名对象放在会话本地命名空间
+static string toMappingName(const string &name)
+{
+    return "Local\\" + name;
+}
+#else
+// POSIX 共享内存名称必须以 '/' 开头
+static string toMappingName(const string &name)
+{
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+#endif
+
+MappedRegion::~MappedRegion()
+{
+    release();
+}
+
+bool MappedRegion::createShared(const string &name, size_t size)
+{
+    release();
+    string mappingName = toMappingName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32),
+                                        static_cast<DWORD>(size & 0xFFFFFFFFu),
+                                        mappingName.c_str());
+    if (mapping == nullptr)
+    {
+        cerr << "错误: 创建共享内存失败: " << name << " (错误码 " << GetLastError() << ")" << endl;
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (view == nullptr)
+    {
+        cerr << "错误: 映射共享内存失败: " << name << " (错误码 " << GetLastError() << ")" << endl;
+        CloseHandle(mapping);
+        return false;
+    }
+
+    m_mappingHandle = mapping;
+    m_data = view;
+#else
+    // 先删除可能残留的同名对象，保证大小和内容是全新的
+    shm_unlink(mappingName.c_str());
+
+    int fd = shm_open(mappingName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0)
+    {
+        cerr << "错误: 创建共享内存失败: " << name << " (" << strerror(errno) << ")" << endl;
+        return false;
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        cerr << "错误: 设置共享内存大小失败: " << name << " (" << strerror(errno) << ")" << endl;
+        close(fd);
+        shm_unlink(mappingName.c_str());
+        return false;
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        cerr << "错误: 映射共享内存失败: " << name << " (" << strerror(errno) << ")" << endl;
+        shm_unlink(mappingName.c_str());
+        return false;
+    }
+
+    m_data = view;
+#endif
+
+    m_size = size;
+    m_sharedName = mappingName;
+    return true;
+}
+
+bool MappedRegion::openShared(const string &name)
+{
+    release();
+    string mappingName = toMappingName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    // 通过 VirtualQuery 获取映射大小
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(view, &info, sizeof(info));
+
+    m_mappingHandle = mapping;
+    m_data = view;
+    m_size = info.RegionSize;
+#else
+    int fd = shm_open(mappingName.c_str(), O_RDWR, 0666);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = view;
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+bool MappedRegion::mapFileReadOnly(const string &path)
+{
+    release();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_data = view;
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = view;
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+void MappedRegion::release()
+{
+    if (m_data == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr)
+    {
+        CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+    }
+    if (m_fileHandle != nullptr)
+    {
+        CloseHandle(static_cast<HANDLE>(m_fileHandle));
+    }
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+#else
+    munmap(m_data, m_size);
+    if (!m_sharedName.empty())
+    {
+        shm_unlink(m_sharedName.c_str());
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    m_sharedName.clear();
+}
@@ -0,0 +1,544 @@
+/*
+ * 声明式处理流水线 - 阶段注册、图解析、裁剪/融合、执行与计时
+ */
+
+#include "stage_graph.h"
+#include "image_processing.h"
+#include "image_decode.h"
+#include "config_constants.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+// 原始输入图像的名字
+static const string INPUT_NAME = "input";
+
+// ==================== 阶段注册 ====================
+
+// 整图阶段：单输入单输出
+static StageDefinition imageStage(const string &name, MemoryStage memoryStage, function<Mat(const Mat &)> fn)
+{
+    StageDefinition definition;
+    definition.name = name;
+    definition.memoryStage = memoryStage;
+    definition.run = [fn](const vector<Mat> &inputs, StageContext &) { return fn(inputs[0]); };
+    return definition;
+}
+
+// 逐像素阶段：只提供逐行处理函数
+static StageDefinition rowStage(const string &name, MemoryStage memoryStage, int outputType,
+                                function<void(const Mat &, Mat &, const StageContext &)> kernel)
+{
+    StageDefinition definition;
+    definition.name = name;
+    definition.memoryStage = memoryStage;
+    definition.rowKernel = kernel;
+    definition.rowOutputType = outputType;
+    return definition;
+}
+
+// 本帧使用的 HSV 范围
+static const vector<HsvRange> &contextHsvRanges(const StageContext &context)
+{
+    return context.recipe ? context.recipe->hsvRanges : defaultHsvRanges();
+}
+
+// BGR → HSV（逐像素）
+static void bgrToHsvRow(const Mat &bgrRow, Mat &hsvRow, const StageContext &)
+{
+    cvtColor(bgrRow, hsvRow, COLOR_BGR2HSV);
+}
+
+// 多HSV范围二值化（逐像素），与 createHueBinaryMask 的结果逐像素一致
+static void hsvThresholdRow(const Mat &hsvRow, Mat &maskRow, const StageContext &context)
+{
+    maskRow.create(hsvRow.size(), CV_8UC1);
+    maskRow.setTo(0);
+
+    static thread_local Mat rangeMask;
+    for (const HsvRange &range : contextHsvRanges(context))
+    {
+        inRange(hsvRow,
+                Scalar(range.hueMin, range.satMin, range.valMin),
+                Scalar(range.hueMax, range.satMax, range.valMax),
+                rangeMask);
+        bitwise_or(maskRow, rangeMask, maskRow);
+    }
+}
+
+// 缩放：目标尺寸按原始分辨率和本帧缩放比例计算（输入可能是缩小解码的结果），EXIF 方向在缩小后的图像上应用
+static Mat resizeStage(const Mat &in, const StageContext &context)
+{
+    if (context.sourceSize.empty() && context.exifOrientation == 1)
+    {
+        return resizeImageByScale(in, context.resizeScale);
+    }
+    if (in.empty())
+    {
+        cerr << "Error: Empty input image for resizing" << endl;
+        return Mat();
+    }
+
+    Size source = context.sourceSize.empty() ? in.size() : context.sourceSize;
+    Size target(max(1, static_cast<int>(source.width * context.resizeScale)),
+                max(1, static_cast<int>(source.height * context.resizeScale)));
+
+    Mat resized;
+    resize(in, resized, target, 0, 0, INTER_LINEAR);
+
+    Mat oriented;
+    applyExifOrientation(resized, oriented, context.exifOrientation);
+
+    frameLog() << "Image resized from " << in.cols << "x" << in.rows
+         << " to " << oriented.cols << "x" << oriented.rows
+         << " (scale: " << context.resizeScale << ", EXIF orientation: " << context.exifOrientation << ")" << endl;
+
+    return oriented;
+}
+
+static map<string, StageDefinition> builtinStages()
+{
+    vector<StageDefinition> stages = {
+        imageStage("blur", MemoryStage::Other, applyBlurProcessing),
+        imageStage("clahe", MemoryStage::Other, enhanceContrast_CLAHE),
+        imageStage("lab_mask", MemoryStage::HsvMask, createLABBinaryMask),
+        rowStage("bgr2hsv", MemoryStage::HsvMask, CV_8UC3, bgrToHsvRow),
+        rowStage("hsv_threshold", MemoryStage::HsvMask, CV_8UC1, hsvThresholdRow),
+        imageStage("morphology", MemoryStage::Morphology, performMorphological),
+        imageStage("contour_fill", MemoryStage::ContourFill, fillContours),
+        imageStage("fill_components", MemoryStage::CcFilter, fillConnectedComponents),
+    };
+
+    StageDefinition resizeDefinition;
+    resizeDefinition.name = "resize";
+    resizeDefinition.memoryStage = MemoryStage::Resize;
+    resizeDefinition.run = [](const vector<Mat> &inputs, StageContext &context) {
+        return resizeStage(inputs[0], context);
+    };
+    stages.push_back(resizeDefinition);
+
+    // HSV 二值化使用本帧配方的颜色范围
+    StageDefinition hsvMask;
+    hsvMask.name = "hsv_mask";
+    hsvMask.memoryStage = MemoryStage::HsvMask;
+    hsvMask.run = [](const vector<Mat> &inputs, StageContext &context) {
+        return createHueBinaryMask(inputs[0], contextHsvRanges(context));
+    };
+    stages.push_back(hsvMask);
+
+    // 连通域过滤同时输出保留下来的连通域统计（供模板匹配使用）
+    StageDefinition ccFilter;
+    ccFilter.name = "cc_filter";
+    ccFilter.memoryStage = MemoryStage::CcFilter;
+    ccFilter.run = [](const vector<Mat> &inputs, StageContext &context) {
+        Mat filtered = filterConnectedComponentsByPercent(inputs[0], Config::CONNECTED_COMPONENT_PERCENT, context.components);
+        context.componentsImage = filtered;
+        return filtered;
+    };
+    stages.push_back(ccFilter);
+
+    map<string, StageDefinition> registry;
+    for (const StageDefinition &stage : stages)
+    {
+        registry[stage.name] = stage;
+    }
+    return registry;
+}
+
+static map<string, StageDefinition> &stageRegistry()
+{
+    static map<string, StageDefinition> registry = builtinStages();
+    return registry;
+}
+
+void registerStage(const StageDefinition &definition)
+{
+    stageRegistry()[definition.name] = definition;
+}
+
+const StageDefinition *findStage(const string &name)
+{
+    auto it = stageRegistry().find(name);
+    return (it != stageRegistry().end()) ? &it->second : nullptr;
+}
+
+vector<string> registeredStageNames()
+{
+    vector<string> names;
+    for (const auto &entry : stageRegistry())
+    {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+// ==================== 图解析 ====================
+
+static string trim(const string &text)
+{
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == string::npos)
+    {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool StageGraph::load(const vector<string> &lines)
+{
+    m_nodes.clear();
+    m_steps.clear();
+    m_compiled = false;
+
+    set<string> defined = {INPUT_NAME};
+
+    for (const string &rawLine : lines)
+    {
+        string line = trim(rawLine);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        // <输出名> = <阶段名>(<输入名>, ...)
+        size_t equalPos = line.find('=');
+        size_t openPos = line.find('(', equalPos == string::npos ? 0 : equalPos);
+        size_t closePos = line.rfind(')');
+        if (equalPos == string::npos || openPos == string::npos || closePos == string::npos || closePos < openPos)
+        {
+            cerr << "错误: 流水线节点格式应为 \"输出 = 阶段(输入, ...)\": " << line << endl;
+            return false;
+        }
+
+        Node node;
+        node.output = trim(line.substr(0, equalPos));
+        node.stage = trim(line.substr(equalPos + 1, openPos - equalPos - 1));
+
+        stringstream inputs(line.substr(openPos + 1, closePos - openPos - 1));
+        string input;
+        while (getline(inputs, input, ','))
+        {
+            input = trim(input);
+            if (!input.empty())
+            {
+                node.inputs.push_back(input);
+            }
+        }
+
+        node.definition = findStage(node.stage);
+        if (node.definition == nullptr)
+        {
+            cerr << "错误: 未注册的流水线阶段 \"" << node.stage << "\"，可用阶段:";
+            for (const string &name : registeredStageNames())
+            {
+                cerr << " " << name;
+            }
+            cerr << endl;
+            return false;
+        }
+
+        int expectedInputs = node.definition->isPerPixel() ? 1 : node.definition->inputCount;
+        if (int(node.inputs.size()) != expectedInputs)
+        {
+            cerr << "错误: 阶段 " << node.stage << " 需要 " << expectedInputs << " 个输入: " << line << endl;
+            return false;
+        }
+
+        for (const string &name : node.inputs)
+        {
+            if (defined.count(name) == 0)
+            {
+                cerr << "错误: 节点 " << node.output << " 的输入 \"" << name << "\" 未在前面定义" << endl;
+                return false;
+            }
+        }
+
+        if (node.output.empty() || defined.count(node.output) != 0)
+        {
+            cerr << "错误: 节点输出名为空或重复: " << line << endl;
+            return false;
+        }
+
+        defined.insert(node.output);
+        m_nodes.push_back(node);
+    }
+
+    if (m_nodes.empty())
+    {
+        cerr << "错误: 流水线为空" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool StageGraph::hasOutput(const string &name) const
+{
+    for (const Node &node : m_nodes)
+    {
+        if (node.output == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ==================== 执行计划 ====================
+
+bool StageGraph::compile(const vector<string> &requiredOutputs)
+{
+    m_steps.clear();
+    m_required.clear();
+    m_skipped.clear();
+    m_compiled = false;
+
+    for (const string &name : requiredOutputs)
+    {
+        if (hasOutput(name))
+        {
+            m_required.push_back(name);
+        }
+    }
+    if (m_required.empty())
+    {
+        cerr << "错误: 流水线中没有任何需要的输出" << endl;
+        return false;
+    }
+
+    // 1. 从需要的输出反向标记有用的节点
+    int nodeCount = int(m_nodes.size());
+    vector<bool> live(nodeCount, false);
+    set<string> needed(m_required.begin(), m_required.end());
+    for (int i = nodeCount - 1; i >= 0; i--)
+    {
+        if (needed.count(m_nodes[i].output) != 0)
+        {
+            live[i] = true;
+            needed.insert(m_nodes[i].inputs.begin(), m_nodes[i].inputs.end());
+        }
+        else
+        {
+            m_skipped.push_back(m_nodes[i].output);
+        }
+    }
+    reverse(m_skipped.begin(), m_skipped.end());
+
+    // 2. 统计每个中间结果的使用者个数
+    map<string, int> consumers;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        if (live[i])
+        {
+            for (const string &input : m_nodes[i].inputs)
+            {
+                consumers[input]++;
+            }
+        }
+    }
+
+    set<string> required(m_required.begin(), m_required.end());
+
+    // 3. 生成执行步骤，相邻逐像素节点（中间结果只有一个使用者且不需要输出）融合为一步
+    map<string, int> lastUseStep;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        if (!live[i])
+        {
+            continue;
+        }
+
+        const Node &node = m_nodes[i];
+        bool fused = false;
+        if (node.definition->isPerPixel() && !m_steps.empty())
+        {
+            const Node &previous = m_nodes[m_steps.back().nodes.back()];
+            fused = previous.definition->isPerPixel() &&
+                    node.inputs[0] == previous.output &&
+                    consumers[previous.output] == 1 &&
+                    required.count(previous.output) == 0;
+        }
+
+        if (fused)
+        {
+            m_steps.back().nodes.push_back(i);
+        }
+        else
+        {
+            Step step;
+            step.nodes.push_back(i);
+            m_steps.push_back(step);
+        }
+
+        for (const string &input : node.inputs)
+        {
+            lastUseStep[input] = int(m_steps.size()) - 1;
+        }
+    }
+
+    // 4. 中间结果在最后一个使用者所在步骤执行后释放
+    for (const auto &entry : lastUseStep)
+    {
+        if (entry.first != INPUT_NAME && required.count(entry.first) == 0)
+        {
+            m_steps[entry.second].releaseAfter.push_back(entry.first);
+        }
+    }
+
+    for (Step &step : m_steps)
+    {
+        for (size_t i = 0; i < step.nodes.size(); i++)
+        {
+            step.label += (i > 0 ? "+" : "") + m_nodes[step.nodes[i]].stage;
+        }
+        if (step.nodes.size() > 1)
+        {
+            step.label = "[" + step.label + "]";
+        }
+    }
+
+    m_compiled = true;
+    return true;
+}
+
+string StageGraph::describe() const
+{
+    string text;
+    for (size_t i = 0; i < m_steps.size(); i++)
+    {
+        text += (i > 0 ? " → " : "") + m_steps[i].label;
+    }
+    if (!m_skipped.empty())
+    {
+        text += "  (跳过:";
+        for (const string &name : m_skipped)
+        {
+            text += " " + name;
+        }
+        text += ")";
+    }
+    return text;
+}
+
+bool StageGraph::runFusedStep(const Step &step, const StageContext &context, map<string, Mat> &slots)
+{
+    const Node &first = m_nodes[step.nodes.front()];
+    const Node &last = m_nodes[step.nodes.back()];
+    const Mat &source = slots[first.inputs[0]];
+    if (source.empty())
+    {
+        cerr << "Error: Empty input image for stage " << step.label << endl;
+        return false;
+    }
+
+    // 逐行依次执行组内所有阶段，中间结果只保留一行
+    Mat result(source.rows, source.cols, last.definition->rowOutputType);
+    vector<Mat> rowBuffers(step.nodes.size() - 1);
+
+    for (int y = 0; y < source.rows; y++)
+    {
+        Mat current = source.row(y);
+        for (size_t i = 0; i < step.nodes.size(); i++)
+        {
+            const StageDefinition *definition = m_nodes[step.nodes[i]].definition;
+            if (i + 1 == step.nodes.size())
+            {
+                Mat outRow = result.row(y);
+                definition->rowKernel(current, outRow, context);
+                if (outRow.data != result.ptr(y))
+                {
+                    // 核函数重新分配了输出行（类型或尺寸与 rowOutputType 不符），结果不会写入整图
+                    cerr << "错误: 阶段 " << m_nodes[step.nodes[i]].stage << " 的逐行输出与声明的类型不一致" << endl;
+                    return false;
+                }
+            }
+            else
+            {
+                definition->rowKernel(current, rowBuffers[i], context);
+                current = rowBuffers[i];
+            }
+        }
+    }
+
+    slots[last.output] = result;
+    return true;
+}
+
+bool StageGraph::execute(const Mat &input, StageContext &context, map<string, Mat> &outputs)
+{
+    if (!m_compiled)
+    {
+        cerr << "错误: 流水线尚未编译" << endl;
+        return false;
+    }
+
+    map<string, Mat> slots;
+    slots[INPUT_NAME] = input;
+
+    for (Step &step : m_steps)
+    {
+        auto stepStart = chrono::steady_clock::now();
+        const Node &first = m_nodes[step.nodes.front()];
+
+        {
+            MemoryStageScope memoryStage(first.definition->memoryStage);
+            if (first.definition->isPerPixel())
+            {
+                if (!runFusedStep(step, context, slots))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                vector<Mat> inputs;
+                for (const string &name : first.inputs)
+                {
+                    inputs.push_back(slots[name]);
+                }
+
+                Mat result = first.definition->run(inputs, context);
+                if (result.empty())
+                {
+                    cerr << "Error: Stage " << first.stage << " produced an empty image" << endl;
+                    return false;
+                }
+                slots[first.output] = result;
+            }
+        }
+
+        for (const string &name : step.releaseAfter)
+        {
+            slots.erase(name);
+        }
+
+        double stepMs = chrono::duration<double, milli>(chrono::steady_clock::now() - stepStart).count();
+        step.calls++;
+        step.totalMs += stepMs;
+        context.stageMs.emplace_back(step.label, stepMs);
+    }
+
+    for (const string &name : m_required)
+    {
+        outputs[name] = slots[name];
+    }
+    return true;
+}
+
+void StageGraph::printTimings() const
+{
+    cout << "========== 流水线节点耗时 ==========" << endl;
+    for (const Step &step : m_steps)
+    {
+        double average = step.calls > 0 ? step.totalMs / step.calls : 0.0;
+        cout << left << setw(32) << step.label << right << fixed << setprecision(3)
+             << setw(10) << average << " ms/帧  (" << step.calls << " 次)" << endl;
+    }
+    cout << "====================================" << endl;
+}
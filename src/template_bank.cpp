@@ -0,0 +1,506 @@
+/*
+ * 模板库模块 - 模板的构建、预编译二进制文件的读写
+ */
+
+#include "template_bank.h"
+#include "config_constants.h"
+#include "image_files.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+namespace fs = std::filesystem;
+
+// ==================== 二进制文件格式 ====================
+//
+// [TemplateBankFileHeader]
+// [TemplateRecord x templateCount]
+// [VariantRecord x variantCount]
+// [像素数据，每个模板变体 64 字节对齐]
+//
+// 所有整数均为生成机器的本地字节序；版本号不匹配时拒绝加载并回退到扫描模板文件夹。
+
+static const char TEMPLATE_BANK_MAGIC[8] = {'T', 'W', 'T', 'B', 'A', 'N', 'K', '\0'};
+constexpr uint32_t TEMPLATE_BANK_VERSION = 3;
+
+struct TemplateBankFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t templateCount;
+    uint32_t variantCount;
+    uint32_t reserved;
+    double rotationMax;
+    double rotationStep;
+    uint64_t fileSize;
+};
+
+struct TemplateRecord
+{
+    char filename[128];
+    double threshold;
+    double axisAngle;      // 0° 模板主轴角度
+    double elongation;     // 0° 模板长短轴比
+    double majorLength;    // 0° 模板主轴长度
+    uint32_t firstVariant; // 在变体表中的起始下标
+    uint32_t variantCount; // 0 表示模板加载失败
+    uint64_t sourceSize;   // 源文件大小
+    int64_t sourceMtime;   // 源文件修改时间
+};
+
+struct VariantRecord
+{
+    double angle;
+    double energy;
+    uint64_t dataOffset; // 像素数据相对文件起始的偏移
+    uint32_t width;
+    uint32_t height;
+    uint32_t step;
+    int32_t whitePixels;
+};
+
+/**
+ * @brief 旋转图像（保持图像完整，不裁剪）
+ * @param src 源图像
+ * @param angle 旋转角度（度，正值为逆时针）
+ * @return 旋转后的图像
+ */
+static Mat rotateImage(const Mat &src, double angle)
+{
+    // 计算旋转中心
+    Point2f center(src.cols / 2.0, src.rows / 2.0);
+
+    // 获取旋转矩阵
+    Mat rotMat = getRotationMatrix2D(center, angle, 1.0);
+
+    // 计算旋转后的边界框尺寸
+    double abs_cos = abs(rotMat.at<double>(0, 0));
+    double abs_sin = abs(rotMat.at<double>(0, 1));
+    int new_w = int(src.rows * abs_sin + src.cols * abs_cos);
+    int new_h = int(src.rows * abs_cos + src.cols * abs_sin);
+
+    // 调整旋转矩阵以适应新尺寸
+    rotMat.at<double>(0, 2) += (new_w / 2.0 - center.x);
+    rotMat.at<double>(1, 2) += (new_h / 2.0 - center.y);
+
+    // 执行旋转
+    Mat rotated;
+    warpAffine(src, rotated, rotMat, Size(new_w, new_h),
+               INTER_LINEAR, BORDER_CONSTANT, Scalar(0));
+
+    return rotated;
+}
+
+// 计算模板变体的统计量
+static void computeVariantStats(TemplateVariant &variant)
+{
+    variant.whitePixels = countNonZero(variant.image);
+    variant.energy = variant.image.dot(variant.image);
+}
+
+// 计算模板主轴方向（先二值化，去掉JPEG压缩带来的低灰度噪声）
+static BlobOrientation computeTemplateOrientation(const Mat &templateImg)
+{
+    Mat templateMask = templateImg > 127;
+    BlobOrientation orientation = orientationFromMoments(moments(templateMask, true));
+    orientation.bbox = Rect(0, 0, templateImg.cols, templateImg.rows);
+    return orientation;
+}
+
+vector<double> buildAngleSequence(double rotationMax, double rotationStep)
+{
+    vector<double> angleSequence;
+    angleSequence.push_back(0.0); // 先测试0度
+    for (double offset = rotationStep; offset <= rotationMax; offset += rotationStep)
+    {
+        angleSequence.push_back(offset);  // 正角度
+        angleSequence.push_back(-offset); // 负角度
+    }
+    return angleSequence;
+}
+
+// 读取源文件的大小和修改时间
+static bool readSourceStamp(const fs::path &path, uint64_t &size, int64_t &mtime)
+{
+    error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+    auto modified = fs::last_write_time(path, ec);
+    if (ec)
+    {
+        return false;
+    }
+    mtime = int64_t(modified.time_since_epoch().count());
+    return true;
+}
+
+bool buildTemplateBank(const string &templateFolder, const vector<double> &thresholds, TemplateBank &bank)
+{
+    bank = TemplateBank();
+
+    // Step 1: 获取模板文件列表（读取文件夹中所有图片文件）
+    vector<string> files;
+    if (!listImageFiles(templateFolder, files, false))
+    {
+        return false;
+    }
+
+    if (files.empty())
+    {
+        cerr << "错误: 模板文件夹中没有找到图片文件" << endl;
+        return false;
+    }
+
+    // Step 2: 验证配置
+    if (files.size() != thresholds.size())
+    {
+        cerr << "错误: 模板数量(" << files.size()
+             << ") != 阈值数量(" << thresholds.size() << ")" << endl;
+        return false;
+    }
+
+    cout << "找到 " << files.size() << " 个模板文件" << endl;
+
+    // Step 3: 解码并预旋转每个模板
+    bank.rotationMax = TemplateMatchConfig::ROTATION_MAX;
+    bank.rotationStep = TemplateMatchConfig::ROTATION_STEP;
+    vector<double> angleSequence = buildAngleSequence(bank.rotationMax, bank.rotationStep);
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        TemplateEntry entry;
+        entry.filename = files[i];
+        entry.threshold = thresholds[i];
+        readSourceStamp(fs::path(templateFolder) / files[i], entry.sourceSize, entry.sourceMtime);
+
+        Mat templateImg = imread(templateFolder + "/" + files[i], IMREAD_GRAYSCALE);
+        if (templateImg.empty())
+        {
+            cerr << "错误: 无法加载模板 " << files[i] << endl;
+            bank.templates.push_back(entry);
+            continue;
+        }
+
+        entry.orientation = computeTemplateOrientation(templateImg);
+
+        for (double angle : angleSequence)
+        {
+            TemplateVariant variant;
+            variant.angle = angle;
+            variant.image = (abs(angle) < 0.01) ? templateImg : rotateImage(templateImg, angle);
+            computeVariantStats(variant);
+            entry.variants.push_back(variant);
+        }
+
+        bank.templates.push_back(entry);
+    }
+
+    return true;
+}
+
+bool saveTemplateBank(const TemplateBank &bank, const string &path)
+{
+    if (bank.templates.empty())
+    {
+        cerr << "错误: 模板库为空，无法保存" << endl;
+        return false;
+    }
+
+    // 组装记录表并计算像素数据布局
+    vector<TemplateRecord> templateRecords;
+    vector<VariantRecord> variantRecords;
+    vector<const Mat *> variantImages;
+
+    for (const TemplateEntry &entry : bank.templates)
+    {
+        if (entry.filename.size() >= sizeof(TemplateRecord::filename))
+        {
+            cerr << "错误: 模板文件名过长: " << entry.filename << endl;
+            return false;
+        }
+
+        TemplateRecord record = {};
+        strncpy(record.filename, entry.filename.c_str(), sizeof(record.filename) - 1);
+        record.threshold = entry.threshold;
+        record.axisAngle = entry.orientation.axisAngle;
+        record.elongation = entry.orientation.elongation;
+        record.majorLength = entry.orientation.majorLength;
+        record.firstVariant = uint32_t(variantRecords.size());
+        record.variantCount = uint32_t(entry.variants.size());
+        record.sourceSize = entry.sourceSize;
+        record.sourceMtime = entry.sourceMtime;
+        templateRecords.push_back(record);
+
+        for (const TemplateVariant &variant : entry.variants)
+        {
+            VariantRecord variantRecord = {};
+            variantRecord.angle = variant.angle;
+            variantRecord.energy = variant.energy;
+            variantRecord.width = variant.image.cols;
+            variantRecord.height = variant.image.rows;
+            variantRecord.step = variant.image.cols;
+            variantRecord.whitePixels = variant.whitePixels;
+            variantRecords.push_back(variantRecord);
+            variantImages.push_back(&variant.image);
+        }
+    }
+
+    uint64_t offset = sizeof(TemplateBankFileHeader) +
+                      templateRecords.size() * sizeof(TemplateRecord) +
+                      variantRecords.size() * sizeof(VariantRecord);
+    for (VariantRecord &variantRecord : variantRecords)
+    {
+        offset = alignUp(offset, 64);
+        variantRecord.dataOffset = offset;
+        offset += uint64_t(variantRecord.step) * variantRecord.height;
+    }
+
+    TemplateBankFileHeader header = {};
+    memcpy(header.magic, TEMPLATE_BANK_MAGIC, sizeof(header.magic));
+    header.version = TEMPLATE_BANK_VERSION;
+    header.templateCount = uint32_t(templateRecords.size());
+    header.variantCount = uint32_t(variantRecords.size());
+    header.rotationMax = bank.rotationMax;
+    header.rotationStep = bank.rotationStep;
+    header.fileSize = offset;
+
+    // 先写临时文件再改名，避免运行中的检测进程映射到写了一半的文件
+    string tempPath = path + ".tmp";
+    {
+        ofstream out(tempPath, ios::binary | ios::trunc);
+        if (!out)
+        {
+            cerr << "错误: 无法创建模板库文件: " << tempPath << endl;
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(templateRecords.data()), templateRecords.size() * sizeof(TemplateRecord));
+        out.write(reinterpret_cast<const char *>(variantRecords.data()), variantRecords.size() * sizeof(VariantRecord));
+
+        for (size_t i = 0; i < variantRecords.size(); i++)
+        {
+            // 补齐到对齐位置
+            uint64_t position = uint64_t(out.tellp());
+            static const char padding[64] = {};
+            out.write(padding, variantRecords[i].dataOffset - position);
+
+            const Mat &image = *variantImages[i];
+            for (int row = 0; row < image.rows; row++)
+            {
+                out.write(reinterpret_cast<const char *>(image.ptr(row)), image.cols);
+            }
+        }
+
+        if (!out)
+        {
+            cerr << "错误: 写入模板库文件失败: " << tempPath << endl;
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec)
+    {
+        cerr << "错误: 无法写入模板库文件 " << path << ": " << ec.message() << endl;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+bool loadTemplateBank(const string &path, TemplateBank &bank)
+{
+    bank = TemplateBank();
+
+    auto mapping = make_shared<MappedRegion>();
+    if (!mapping->mapFileReadOnly(path))
+    {
+        return false;
+    }
+
+    const uint8_t *base = static_cast<const uint8_t *>(mapping->data());
+    size_t fileSize = mapping->size();
+
+    // 校验文件头
+    if (fileSize < sizeof(TemplateBankFileHeader))
+    {
+        cerr << "错误: 模板库文件过小: " << path << endl;
+        return false;
+    }
+
+    const TemplateBankFileHeader *header = reinterpret_cast<const TemplateBankFileHeader *>(base);
+    if (memcmp(header->magic, TEMPLATE_BANK_MAGIC, sizeof(header->magic)) != 0)
+    {
+        cerr << "错误: 不是模板库文件: " << path << endl;
+        return false;
+    }
+    if (header->version != TEMPLATE_BANK_VERSION)
+    {
+        cerr << "错误: 模板库文件版本(" << header->version << ")与程序版本("
+             << TEMPLATE_BANK_VERSION << ")不一致，请重新运行 compile-templates" << endl;
+        return false;
+    }
+
+    uint64_t tablesEnd = sizeof(TemplateBankFileHeader) +
+                         uint64_t(header->templateCount) * sizeof(TemplateRecord) +
+                         uint64_t(header->variantCount) * sizeof(VariantRecord);
+    if (header->fileSize != fileSize || tablesEnd > fileSize)
+    {
+        cerr << "错误: 模板库文件已损坏: " << path << endl;
+        return false;
+    }
+
+    const TemplateRecord *templateRecords = reinterpret_cast<const TemplateRecord *>(base + sizeof(TemplateBankFileHeader));
+    const VariantRecord *variantRecords = reinterpret_cast<const VariantRecord *>(templateRecords + header->templateCount);
+
+    bank.rotationMax = header->rotationMax;
+    bank.rotationStep = header->rotationStep;
+
+    for (uint32_t i = 0; i < header->templateCount; i++)
+    {
+        const TemplateRecord &record = templateRecords[i];
+        if (uint64_t(record.firstVariant) + record.variantCount > header->variantCount)
+        {
+            cerr << "错误: 模板库文件已损坏: " << path << endl;
+            return false;
+        }
+
+        TemplateEntry entry;
+        entry.filename = string(record.filename, strnlen(record.filename, sizeof(record.filename)));
+        entry.threshold = record.threshold;
+        entry.orientation.axisAngle = record.axisAngle;
+        entry.orientation.elongation = record.elongation;
+        entry.orientation.majorLength = record.majorLength;
+        entry.sourceSize = record.sourceSize;
+        entry.sourceMtime = record.sourceMtime;
+
+        for (uint32_t v = 0; v < record.variantCount; v++)
+        {
+            const VariantRecord &variantRecord = variantRecords[record.firstVariant + v];
+
+            // 像素区域必须在表之后、完整落在映射内，且每行步长不小于宽度（逐项比较，避免相加溢出）
+            uint64_t pixelBytes = uint64_t(variantRecord.step) * variantRecord.height;
+            if (variantRecord.width == 0 || variantRecord.height == 0 ||
+                variantRecord.width > uint32_t(INT32_MAX) || variantRecord.height > uint32_t(INT32_MAX) ||
+                variantRecord.step < variantRecord.width ||
+                variantRecord.dataOffset < tablesEnd || variantRecord.dataOffset > fileSize ||
+                pixelBytes > fileSize - variantRecord.dataOffset)
+            {
+                cerr << "错误: 模板库文件已损坏: " << path << endl;
+                return false;
+            }
+
+            // 模板像素直接指向只读映射，不拷贝
+            TemplateVariant variant;
+            variant.angle = variantRecord.angle;
+            variant.image = Mat(variantRecord.height, variantRecord.width, CV_8UC1,
+                                const_cast<uint8_t *>(base + variantRecord.dataOffset), variantRecord.step);
+            variant.whitePixels = variantRecord.whitePixels;
+            variant.energy = variantRecord.energy;
+            entry.variants.push_back(variant);
+        }
+
+        bank.templates.push_back(entry);
+    }
+
+    bank.mapping = mapping;
+    return true;
+}
+
+/**
+ * @brief 核对模板库与模板文件夹、角度配置是否一致（阈值以配方为准，加载后由配方覆盖，不参与核对）
+ * @param reason 输出：不一致的原因
+ * @return 一致返回 true
+ */
+static bool templateBankMatchesSources(const TemplateBank &bank, const string &templateFolder, string &reason)
+{
+    if (bank.rotationMax != TemplateMatchConfig::ROTATION_MAX ||
+        bank.rotationStep != TemplateMatchConfig::ROTATION_STEP)
+    {
+        reason = "角度配置已变更";
+        return false;
+    }
+
+    vector<string> files;
+    if (!listImageFiles(templateFolder, files, false))
+    {
+        reason = "无法读取模板文件夹";
+        return false;
+    }
+    if (files.size() != bank.templates.size())
+    {
+        reason = "模板数量 " + to_string(bank.templates.size()) + " -> " + to_string(files.size());
+        return false;
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const TemplateEntry &entry = bank.templates[i];
+        if (entry.filename != files[i])
+        {
+            reason = "模板文件 " + entry.filename + " -> " + files[i];
+            return false;
+        }
+
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        if (!readSourceStamp(fs::path(templateFolder) / files[i], size, mtime) ||
+            size != entry.sourceSize || mtime != entry.sourceMtime)
+        {
+            reason = "模板文件 " + files[i] + " 已修改";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool templateBankUpToDate(const string &bankFile, const string &templateFolder, string &reason)
+{
+    TemplateBank bank;
+    if (bankFile.empty() || !fs::exists(bankFile))
+    {
+        reason = "模板库文件不存在";
+        return false;
+    }
+    if (!loadTemplateBank(bankFile, bank))
+    {
+        reason = "模板库文件不可用";
+        return false;
+    }
+    return templateBankMatchesSources(bank, templateFolder, reason);
+}
+
+bool prepareTemplateBank(const string &bankFile, const string &templateFolder,
+                         const vector<double> &thresholds, TemplateBank &bank)
+{
+    // 启动时只 mmap 并校验版本和大小，不遍历模板文件夹；源文件是否变化由 compile-templates 核对
+    if (!bankFile.empty() && fs::exists(bankFile))
+    {
+        if (loadTemplateBank(bankFile, bank))
+        {
+            cout << "已加载预编译模板库 " << bankFile << " (" << bank.templates.size() << " 个模板)" << endl;
+
+            if (bank.rotationMax != TemplateMatchConfig::ROTATION_MAX ||
+                bank.rotationStep != TemplateMatchConfig::ROTATION_STEP)
+            {
+                cerr << "警告: 模板库的角度配置与当前配置不一致，以模板库为准（请重新运行 compile-templates）" << endl;
+            }
+            return true;
+        }
+
+        cerr << "警告: 模板库文件不可用，回退到扫描模板文件夹" << endl;
+    }
+
+    return buildTemplateBank(templateFolder, thresholds, bank);
+}
@@ -0,0 +1,422 @@
+/*
+ * 工作线程拓扑 - OpenCV 线程数、CPU/NUMA 绑定与线程调度统计
+ */
+
+#include "thread_topology.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static int logicalCpuCount()
+{
+    return max(1, int(thread::hardware_concurrency()));
+}
+
+// 解析 CPU 列表 "0-3,8,10-11"
+static bool parseCpuList(const string &text, vector<int> &cpus)
+{
+    cpus.clear();
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        if (item.empty() || item == "\n")
+        {
+            continue;
+        }
+        size_t dash = item.find('-');
+        char *end = nullptr;
+        long first = strtol(item.c_str(), &end, 10);
+        long last = first;
+        if (dash != string::npos)
+        {
+            last = strtol(item.c_str() + dash + 1, &end, 10);
+        }
+        if (end == item.c_str() || first < 0 || last < first)
+        {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(int(cpu));
+        }
+    }
+    sort(cpus.begin(), cpus.end());
+    cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+static string formatCpuList(const vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return "-";
+    }
+
+    // 连续编号合并为区间
+    string text;
+    for (size_t i = 0; i < cpus.size();)
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+        {
+            j++;
+        }
+        text += (text.empty() ? "" : ",") + to_string(cpus[i]);
+        if (j > i)
+        {
+            text += "-" + to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text;
+}
+
+// 各 NUMA 节点的 CPU 集合（取不到时视为一个包含所有逻辑核的节点）
+static vector<vector<int>> numaNodeCpus()
+{
+    vector<vector<int>> nodes;
+
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+    {
+        for (ULONG node = 0; node <= highestNode; node++)
+        {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask(UCHAR(node), &mask) || mask == 0)
+            {
+                continue;
+            }
+            vector<int> cpus;
+            for (int cpu = 0; cpu < 64; cpu++)
+            {
+                if (mask & (1ULL << cpu))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            nodes.push_back(cpus);
+        }
+    }
+#elif defined(__linux__)
+    for (int node = 0;; node++)
+    {
+        ifstream file("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+        if (!file.is_open())
+        {
+            break;
+        }
+        string text;
+        getline(file, text);
+        vector<int> cpus;
+        if (parseCpuList(text, cpus))
+        {
+            nodes.push_back(cpus);
+        }
+    }
+#endif
+
+    if (nodes.empty())
+    {
+        vector<int> all;
+        for (int cpu = 0; cpu < logicalCpuCount(); cpu++)
+        {
+            all.push_back(cpu);
+        }
+        nodes.push_back(all);
+    }
+    return nodes;
+}
+
+bool parseAffinitySpec(const string &spec, ThreadTopology &topology)
+{
+    topology.cpuList.clear();
+    if (spec == "none")
+    {
+        topology.affinity = AffinityMode::None;
+    }
+    else if (spec == "cores")
+    {
+        topology.affinity = AffinityMode::Cores;
+    }
+    else if (spec == "numa")
+    {
+        topology.affinity = AffinityMode::NumaNodes;
+    }
+    else if (parseCpuList(spec, topology.cpuList))
+    {
+        topology.affinity = AffinityMode::CpuList;
+    }
+    else
+    {
+        cerr << "错误: 无法解析 --affinity \"" << spec << "\"（应为 none / cores / numa / CPU列表如 0-3,8）" << endl;
+        return false;
+    }
+    return true;
+}
+
+void printTopologyPlan(const ThreadTopology &topology)
+{
+    static const char *const AFFINITY_NAMES[] = {"none", "cores", "numa", "cpu_list"};
+
+    int cpuCount = logicalCpuCount();
+    int threadsPerWorker = topology.cvThreads > 0 ? topology.cvThreads : cv::getNumThreads();
+
+    cout << "工作线程拓扑: " << topology.workers << " 个工作线程 × OpenCV "
+         << (topology.cvThreads >= 0 ? to_string(topology.cvThreads) : "默认(" + to_string(cv::getNumThreads()) + ")")
+         << " 线程, 绑定 " << AFFINITY_NAMES[int(topology.affinity)];
+    if (topology.affinity == AffinityMode::CpuList)
+    {
+        cout << " [" << formatCpuList(topology.cpuList) << "]";
+    }
+    cout << ", 逻辑核 " << cpuCount << endl;
+
+    if (topology.workers * max(1, threadsPerWorker) > cpuCount)
+    {
+        cout << "警告: 工作线程数 × OpenCV 线程数 (" << topology.workers * max(1, threadsPerWorker)
+             << ") 超过逻辑核数 (" << cpuCount << ")，CPU 超额订阅，尾延迟会变差" << endl;
+    }
+}
+
+bool checkTopology(const ThreadTopology &topology)
+{
+    int threadsPerWorker = topology.cvThreads >= 0 ? topology.cvThreads : cv::getNumThreads();
+    if (topology.workers <= 1 || threadsPerWorker <= 1)
+    {
+        return true;
+    }
+
+    // OpenMP 后端的线程组由每个调用线程各自创建，继承的是各自的绑定，不受影响
+    string framework = cv::currentParallelFramework() ? cv::currentParallelFramework() : "";
+    if (framework == "openmp")
+    {
+        return true;
+    }
+
+    if (topology.affinity == AffinityMode::Cores)
+    {
+        cerr << "错误: --affinity cores 与 " << topology.workers << " 个工作线程 × OpenCV " << threadsPerWorker
+             << " 线程不能同时使用：OpenCV 线程池（" << (framework.empty() ? "默认" : framework)
+             << " 后端）是进程级的，会继承 0 号工作线程的绑定。请使用 --cv-threads 1 或其他绑定方式" << endl;
+        return false;
+    }
+    if (topology.affinity == AffinityMode::NumaNodes)
+    {
+        cerr << "警告: --affinity numa 下 OpenCV 线程池是进程级的，会继承 0 号工作线程的 NUMA 节点绑定，"
+             << "其他节点上的工作线程的并行部分会跨节点执行；建议 --cv-threads 1" << endl;
+    }
+    return true;
+}
+
+vector<int> workerCpuSet(const ThreadTopology &topology, int workerIndex)
+{
+    vector<int> cpus;
+    switch (topology.affinity)
+    {
+    case AffinityMode::Cores:
+    {
+        // 每个工作线程独占 T 个连续逻辑核（T 为 OpenCV 线程数），超出逻辑核数时回绕
+        int cpuCount = logicalCpuCount();
+        int perWorker = max(1, topology.cvThreads);
+        for (int i = 0; i < perWorker; i++)
+        {
+            cpus.push_back((workerIndex * perWorker + i) % cpuCount);
+        }
+        sort(cpus.begin(), cpus.end());
+        cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+        break;
+    }
+    case AffinityMode::NumaNodes:
+    {
+        vector<vector<int>> nodes = numaNodeCpus();
+        cpus = nodes[workerIndex % nodes.size()];
+        break;
+    }
+    case AffinityMode::CpuList:
+        cpus = topology.cpuList;
+        break;
+    default:
+        break;
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return false;
+    }
+
+#ifdef _WIN32
+    // SetThreadAffinityMask 只能绑定当前处理器组（最多64个逻辑核）
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+    {
+        if (cpu < int(sizeof(DWORD_PTR) * 8))
+        {
+            mask |= DWORD_PTR(1) << cpu;
+        }
+    }
+    if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+    {
+        cerr << "警告: 绑定 CPU [" << formatCpuList(cpus) << "] 失败 (错误码 " << GetLastError() << ")" << endl;
+        return false;
+    }
+    return true;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0)
+    {
+        cerr << "警告: 绑定 CPU [" << formatCpuList(cpus) << "] 失败 (错误码 " << error << ")" << endl;
+        return false;
+    }
+    return true;
+#else
+    cerr << "警告: 当前平台不支持线程绑定，忽略 --affinity" << endl;
+    return false;
+#endif
+}
+
+vector<int> applyWorkerTopology(const ThreadTopology &topology, int workerIndex)
+{
+    // 先绑定再设置线程数：OpenCV 线程池的线程由首次并行调用的线程创建，并继承该线程的绑定
+    vector<int> cpus = workerCpuSet(topology, workerIndex);
+    if (!cpus.empty() && !pinCurrentThread(cpus))
+    {
+        cpus.clear();
+    }
+
+    if (topology.cvThreads >= 0)
+    {
+        cv::setNumThreads(topology.cvThreads);
+    }
+    return cpus;
+}
+
+ThreadSchedSample sampleCurrentThread()
+{
+    ThreadSchedSample sample;
+    sample.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+
+#ifdef _WIN32
+    // Windows 没有线程级上下文切换/运行队列计数的公开接口，只统计 CPU 时间
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        auto to100ns = [](const FILETIME &time)
+        { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+        sample.cpuMs = (to100ns(kernelTime) + to100ns(userTime)) / 1e4;
+    }
+#elif defined(__linux__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0)
+    {
+        sample.switchesAvailable = true;
+        sample.voluntarySwitches = uint64_t(usage.ru_nvcsw);
+        sample.involuntarySwitches = uint64_t(usage.ru_nivcsw);
+        sample.cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+                       (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    }
+
+    // schedstat: 运行时间(ns) 运行队列等待时间(ns) 时间片数（需要内核开启 schedstats）
+    long tid = syscall(SYS_gettid);
+    ifstream schedstat("/proc/self/task/" + to_string(tid) + "/schedstat");
+    uint64_t runNs = 0;
+    uint64_t waitNs = 0;
+    if (schedstat >> runNs >> waitNs)
+    {
+        sample.runQueueAvailable = true;
+        sample.cpuMs = runNs / 1e6;
+        sample.runQueueWaitMs = waitNs / 1e6;
+    }
+#endif
+
+    return sample;
+}
+
+void printWorkerSchedReports(const ThreadTopology &topology, const vector<WorkerSchedReport> &reports)
+{
+    if (reports.empty())
+    {
+        return;
+    }
+
+    bool switchesAvailable = reports.front().end.switchesAvailable;
+    bool runQueueAvailable = reports.front().end.runQueueAvailable;
+
+    cout << "========== 工作线程调度统计 ==========" << endl;
+    cout << "OpenCV 线程数: " << cv::getNumThreads()
+         << (topology.cvThreads >= 0 ? "" : " (默认)") << endl;
+    cout << "（vol_csw 主动让出 CPU 次数，invol_csw 被抢占次数，runq_ms 就绪后在运行队列中等待 CPU 的时间）" << endl;
+    cout << left << setw(8) << "worker" << setw(14) << "cpus" << right << setw(8) << "frames"
+         << setw(12) << "wall_ms" << setw(12) << "cpu_ms" << setw(10) << "vol_csw"
+         << setw(10) << "invol_csw" << setw(14) << "runq_ms" << setw(12) << "runq/frame" << endl;
+
+    for (const WorkerSchedReport &report : reports)
+    {
+        double wallMs = report.end.wallMs - report.start.wallMs;
+        double cpuMs = report.end.cpuMs - report.start.cpuMs;
+        double waitMs = report.end.runQueueWaitMs - report.start.runQueueWaitMs;
+
+        cout << left << setw(8) << report.worker << setw(14) << formatCpuList(report.cpus) << right
+             << setw(8) << report.frames << fixed << setprecision(1)
+             << setw(12) << wallMs << setw(12) << cpuMs;
+        if (switchesAvailable)
+        {
+            cout << setw(10) << (report.end.voluntarySwitches - report.start.voluntarySwitches)
+                 << setw(10) << (report.end.involuntarySwitches - report.start.involuntarySwitches);
+        }
+        else
+        {
+            cout << setw(10) << "-" << setw(10) << "-";
+        }
+        if (runQueueAvailable)
+        {
+            cout << setw(14) << waitMs << setprecision(3)
+                 << setw(12) << (report.frames > 0 ? waitMs / report.frames : 0.0);
+        }
+        else
+        {
+            cout << setw(14) << "-" << setw(12) << "-";
+        }
+        cout << endl;
+    }
+
+    if (!switchesAvailable || !runQueueAvailable)
+    {
+        cout << "（当前平台不提供线程级上下文切换或运行队列等待统计，以 - 表示）" << endl;
+    }
+    cout << "====================================" << endl;
+}
@@ -0,0 +1,179 @@
+/*
+ * 检测结果查看器 - 独立线程渲染，检测线程只需投递结果
+ */
+
+#include "viewer.h"
+#include "display.h"
+
+using namespace cv;
+using namespace std;
+
+// 查看器轮询邮箱的间隔（waitKey 同时处理窗口事件）
+static const int VIEWER_POLL_MS = 10;
+
+// 像素信息叠加层尺寸（位于画布右下角）
+static const int OVERLAY_WIDTH = 330;
+static const int OVERLAY_HEIGHT = 28;
+
+// ==================== FrameMailbox ====================
+
+void FrameMailbox::post(shared_ptr<ViewerFrame> frame)
+{
+    shared_ptr<ViewerFrame> dropped;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        dropped = move(m_latest);
+        m_latest = move(frame);
+    }
+
+    // 被覆盖的帧在锁外释放，避免在锁内析构大图
+    if (dropped)
+    {
+        m_overwritten++;
+    }
+}
+
+shared_ptr<ViewerFrame> FrameMailbox::take()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return move(m_latest);
+}
+
+// ==================== DetectionViewer ====================
+
+DetectionViewer::~DetectionViewer()
+{
+    stop();
+}
+
+void DetectionViewer::start(const string &windowName)
+{
+    if (m_thread.joinable())
+    {
+        return;
+    }
+
+    m_windowName = windowName;
+    m_stopRequested = false;
+    m_running = true;
+    m_thread = thread(&DetectionViewer::run, this);
+}
+
+void DetectionViewer::post(shared_ptr<ViewerFrame> frame)
+{
+    // 用户已关闭窗口时直接丢弃，检测继续进行
+    if (!m_running)
+    {
+        return;
+    }
+    m_mailbox.post(move(frame));
+}
+
+void DetectionViewer::stop(bool waitForClose)
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    m_waitForClose = waitForClose;
+    m_stopRequested = true;
+    m_thread.join();
+}
+
+void DetectionViewer::run()
+{
+    namedWindow(m_windowName, WINDOW_AUTOSIZE);
+    setMouseCallback(m_windowName, &DetectionViewer::mouseCallback, this);
+
+    while (true)
+    {
+        shared_ptr<ViewerFrame> frame = m_mailbox.take();
+        if (frame)
+        {
+            render(*frame);
+            imshow(m_windowName, m_displayCanvas);
+            m_rendered++;
+        }
+        else if (m_stopRequested)
+        {
+            // 最后一帧已显示：需要时保持窗口直到用户按键
+            if (m_waitForClose && m_rendered > 0)
+            {
+                waitKey(0);
+            }
+            break;
+        }
+
+        int key = waitKey(VIEWER_POLL_MS);
+        if (key == 27) // ESC 关闭查看器，不影响检测
+        {
+            break;
+        }
+    }
+
+    m_running = false;
+    setMouseCallback(m_windowName, nullptr, nullptr);
+    destroyWindow(m_windowName);
+}
+
+void DetectionViewer::render(const ViewerFrame &frame)
+{
+    // 基础画布尺寸固定，create 不会重新分配内存
+    vector<string> titles = {
+        "1. Original Image",
+        "2. Resized Image",
+        "3. HSV Binary Mask",
+        "4. Morphological",
+        "5. Contour Filled",
+        "6. Final Result"};
+    renderDetectionCanvas(frame.panels, titles, frame.matchResults, frame.isOK,
+                          frame.algorithmMs, frame.totalMs, m_baseCanvas);
+
+    // 在处理时间下方显示图片名
+    putText(m_baseCanvas, frame.name, Point(10, 90), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(200, 200, 200), 1);
+
+    m_baseCanvas.copyTo(m_displayCanvas);
+    m_crosshairRect = Rect();
+    m_overlayRect = Rect(m_displayCanvas.cols - OVERLAY_WIDTH - 10, m_displayCanvas.rows - OVERLAY_HEIGHT - 10,
+                         OVERLAY_WIDTH, OVERLAY_HEIGHT);
+}
+
+void DetectionViewer::onMouseMove(int x, int y)
+{
+    if (m_displayCanvas.empty() || x < 0 || y < 0 || x >= m_displayCanvas.cols || y >= m_displayCanvas.rows)
+    {
+        return;
+    }
+
+    // 只恢复上一次十字标记和叠加层覆盖的区域
+    if (m_crosshairRect.area() > 0)
+    {
+        m_baseCanvas(m_crosshairRect).copyTo(m_displayCanvas(m_crosshairRect));
+    }
+    m_baseCanvas(m_overlayRect).copyTo(m_displayCanvas(m_overlayRect));
+
+    Vec3b pixel = m_baseCanvas.at<Vec3b>(y, x);
+
+    // 绘制新的十字标记
+    line(m_displayCanvas, Point(x - 10, y), Point(x + 10, y), Scalar(0, 255, 0), 2);
+    line(m_displayCanvas, Point(x, y - 10), Point(x, y + 10), Scalar(0, 255, 0), 2);
+    m_crosshairRect = Rect(x - 11, y - 11, 23, 23) & Rect(0, 0, m_displayCanvas.cols, m_displayCanvas.rows);
+
+    // 绘制像素信息
+    rectangle(m_displayCanvas, m_overlayRect, Scalar(20, 20, 20), -1);
+    string info = "Pos:(" + to_string(x) + "," + to_string(y) + ") RGB:(" + to_string(pixel[2]) + "," +
+                  to_string(pixel[1]) + "," + to_string(pixel[0]) + ")";
+    putText(m_displayCanvas, info, Point(m_overlayRect.x + 5, m_overlayRect.y + 19),
+            FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 255), 1);
+
+    imshow(m_windowName, m_displayCanvas);
+}
+
+void DetectionViewer::mouseCallback(int event, int x, int y, int /*flags*/, void *userdata)
+{
+    if (event == EVENT_MOUSEMOVE && userdata != nullptr)
+    {
+        static_cast<DetectionViewer *>(userdata)->onMouseMove(x, y);
+    }
+}
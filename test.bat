@@ -64,6 +64,10 @@ if not exist "!IMAGE_FOLDER_PATH!" (
     exit /b 1
 )
 
+REM 预编译模板库（模板文件夹未变化时跳过），后续每张图片启动时直接映射，跳过模板扫描和解码
+echo 预编译模板库...
+"build\Release\tableware_detection.exe" compile-templates
+
 echo 扫描图片文件...
 set /a count=0
 set /a success=0